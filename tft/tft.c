@@ -190,11 +190,14 @@ const byte FONT_CHARS[160][5] PROGMEM =
 {0x7c, 0x10, 0x38, 0x44, 0x38},//        0xBE
 {0x08, 0x54, 0x34, 0x14, 0x7c} //        0xBF
 }; // <-};
+byte maxX = XMAX, maxY = YMAX;  // screen limits in the current orientation
+byte clipX0, clipY0, clipX1 = XMAX, clipY1 = YMAX;  // drawing clip rectangle
+byte conFixed, conRows, conOfs;  // console: header rows, scrolled rows (0 = off), scroll in lines
 
 void SetupPorts() //init ports
 {
 	DDRB = 0b11110000;  //set B4-B7 as outputs
-	SetBit(PORTB,6);  // start with TFT reset line inactive high
+	ResetHigh();  // start with TFT reset line inactive high
 }
 void msDelay(int delay)  // put into a routine
 {  // to remove code inlining
@@ -219,6 +222,78 @@ unsigned long intsqrt(unsigned long val)
 	}
 return retVal; 
 }
+//  ---------------------------------------------------------------------------//  SPI TRAFFIC ACCOUNTING
+#ifdef TFT_STATS
+TftStat tftStats[STAT_COUNT];  // traffic per primitive
+byte statPrim, statDepth;  // primitive being charged, nesting level
+byte statRam;  // nonzero while data bytes are pixel data
+const char STAT_NAMES[STAT_COUNT][14] PROGMEM =
+{
+	"other", "ClearScreen", "DrawPixel", "HLine", "VLine", "Line", "DrawRect",
+	"FillRect", "Circle", "RoundRect", "FillCircle", "Ellipse", "FillEllipse",
+	"PutCh", "FillRoundRect", "WriteString", "StripAdd", "SceneUpdate",
+	"Composite", "BandCommit", "MonoFlush", "JobRun", "PixelStream", "DrawPixels"
+};
+void StatEnter(byte prim)
+// charge traffic to prim until the matching StatLeave
+{
+	if (statDepth++ == 0)
+	{
+		statPrim = prim;
+		tftStats[prim].calls++;
+	}
+}
+void StatLeave()
+{
+	statDepth--;
+}
+TftStat *StatCurrent()
+{
+	return &tftStats[statDepth ? statPrim : STAT_OTHER];
+}
+void StatCmd(byte cmd)
+{
+	StatCurrent()->commands++;
+	statRam = (cmd == RAMWR);  // data after RAMWR is pixel data
+}
+void StatData(unsigned long n)
+{
+	if (statRam)
+		StatCurrent()->pixels += n;
+	else
+		StatCurrent()->params += n;
+}
+void StatWindow()
+{
+	StatCurrent()->windows++;
+}
+void StatsClear()
+{
+	memset(tftStats,0,sizeof(tftStats));
+}
+void StatsReport(void (*emit)(char *line))
+// CSV report: name,calls,commands,params,pixels,windows
+{
+	char line[80];
+	strcpy(line,"primitive,calls,commands,params,pixels,windows");
+	emit(line);
+	for (byte i=0; i<STAT_COUNT; i++)
+	{
+		TftStat *st = &tftStats[i];
+		unsigned long v[5] = { st->calls, st->commands, st->params, st->pixels, st->windows };
+		byte n = 0;
+		while ((line[n] = pgm_read_byte(&STAT_NAMES[i][n])))
+			n++;
+		for (byte j=0; j<5; j++)
+		{
+			line[n++] = ',';
+			ltoa(v[j],line+n,10);
+			n += strlen(line+n);
+		}
+		emit(line);
+	}
+}
+#endif
 //  ---------------------------------------------------------------------------//  SPI ROUTINES
 //
 // b7 b6 b5 b4 b3 b2 b1 b0 
@@ -236,32 +311,135 @@ return retVal;
 // SPCR = 0x50: SPI enabled as Master, mode 0, at 16/4 = 4 MHz
 void OpenSPI() //start of spi transfer
 {
+#ifdef TFT_USART_SPI
+	UBRR0 = 0;  // baud rate must be 0 while the transmitter is enabled
+	SetBit(DDRD,4);  // XCK as output selects master mode
+	UCSR0C = _BV(UMSEL01) | _BV(UMSEL00);  // Master SPI mode, Mode0, MSB first
+	UCSR0B = _BV(TXEN0);  // transmitter only
+	UBRR0 = 0;  // SCK = osc/2, same as the SPI port with SPI2X
+	DcCommand();  // send a NOP so TXC0 is set and SpiDrain has
+	SpiOut(0x00);  // something to wait for
+	SpiDrain();
+	DcData();
+#else
 	SPCR = 0x50;  // SPI enabled as Master, Mode0 at 4 MHz 
 	SetBit(SPSR,SPI2X);  // double the SPI rate: 4-->8 MHz 
+#endif
 }
 void CloseSPI() //start of spi transfer
 {
+#ifdef TFT_USART_SPI
+	SpiDrain();
+	UCSR0B = 0x00;  // transmitter off
+#else
 	SPCR = 0x00;  // clear SPI enable bit
+#endif
 }
 
 byte Xfer(byte data) //transfer routine
 {
-	SPDR = data;  // initiate transfer
-	while (!(SPSR & 0x80));  // wait for transfer to complete
-	return SPDR;
+	SpiOut(data);  // initiate transfer
+	SpiWait();  // wait for transfer to complete
+	return SpiIn();
+}
+void SetSpiDivider (byte divider)
+// SCK = osc/divider: 2, 4, 8 ... 128. Queued pump runs finish first.
+{
+	PumpWait();
+#ifdef TFT_USART_SPI
+	SpiDrain();
+	UBRR0 = divider/2 - 1;  // osc/(2*(UBRR0+1))
+#else
+	byte k = 0;  // log2 of the divider
+	while (divider > 1 && k < 7)
+	{
+		divider >>= 1;
+		k++;
+	}
+	if (k == 0) k = 1;
+	SPCR = (SPCR & ~0x03) | (k == 7 ? 3 : (k-1)/2);  // SPR1:0
+	if ((k & 1) && k < 7)
+		SetBit(SPSR,SPI2X);  // odd powers halve the SPR divider
+	else
+		ClearBit(SPSR,SPI2X);
+#endif
+}
+unsigned int SpiByteCycles()
+// CPU cycles per byte at the configured SCK
+{
+#ifdef TFT_USART_SPI
+	return 16 * (UBRR0+1);
+#else
+	static const byte divider[4] = { 4, 16, 64, 128 };
+	unsigned int cycles = 8 * divider[SPCR & 0x03];
+	if (SPSR & _BV(SPI2X))
+		cycles /= 2;
+	return cycles;
+#endif
+}
+byte winX0, winY0, winX1, winY1;  // address window the controller holds
+byte winValid;  // 0 when that window is unknown
+byte pix444;  // nonzero in 12-bit mode (COLMOD 3)
+byte pixStart;  // next pixel is the first of the RAMWR
+byte pixOdd;  // pixHalf waits for a second pixel
+int pixFirst, pixHalf;  // RGB444: first pixel of the RAMWR, unpaired pixel
+unsigned int pixLeft;  // pixels left in the window; 0 if unknown
+void Pad444()
+// send the unpaired pixel. If it ends the window, its partner is the
+// window's first pixel: the write pointer wraps back onto it, and it
+// keeps its color. A stream stopped short reopens a one-pixel window
+// on the unpaired pixel, so the unwritten pixel after it is untouched.
+{
+	int partner = pixFirst;
+	if (!pixOdd)
+		return;
+	pixOdd = 0;
+	if (pixLeft)  // short: the pointer is at pixel area-pixLeft-1
+	{
+		byte width = winX1-winX0+1;
+		unsigned int k = (winX1-winX0+1) * (winY1-winY0+1) - pixLeft - 1;
+		byte x = winX0 + k % width, y = winY0 + k / width;
+		SetAddrWindow(x,y,x,y);
+		WriteCmd(RAMWR);
+		partner = pixHalf;  // wraps onto the same pixel
+	}
+	StatData(3);
+	Xfer(pixHalf >> 4);
+	Xfer(((pixHalf & 0x0F) << 4) | (partner >> 8));
+	Xfer(partner & 0xFF);
+	pixLeft = 0;
 }
 void WriteCmd (byte cmd) //write command to tft
 {
-	ClearBit(PORTB,4);  // B1=DC; 0=command, 1=data
+#ifdef TFT_MONO_FB
+	if (monoActive && cmd == RAMWR)  // framebuffer: restart the write pointer
+	{
+		MonoRamwr();
+		return;
+	}
+#endif
+	PumpWait();  // let queued runs finish first
+	Pad444();  // a 12-bit pixel pair must not be cut by the command
+	if (cmd == RAMWR)
+	{
+		pixStart = 1;
+		pixLeft = winValid ? (winX1-winX0+1) * (winY1-winY0+1) : 0;
+	}
+	StatCmd(cmd);
+	SpiDrain();  // D/C must not change under a byte in flight
+	DcCommand();  // B4=DC; 0=command, 1=data
 	Xfer(cmd);
-	SetBit(PORTB,4);  // return DC high 
+	SpiDrain();
+	DcData();  // return DC high 
 }
 void WriteByte (byte b) //write 8 bit data to tft
 {
+	StatData(1);
 	Xfer(b);
 }
 void WriteWord (int w) //write 16 bit data to tft
 {
+	StatData(2);
 	Xfer(w >> 8);  // write upper 8 bits
 	Xfer(w & 0xFF);  // write lower 8 bits
 }
@@ -277,106 +455,940 @@ void Write888 (long data, int count) //write 24 bit data to tft
 		WriteByte(blue);
 	}
 }
-void Write565 (int data, unsigned int count)
+void Stream565 (int data, unsigned long count)
+// fill kernel: send count pixels of one color, RAMWR already sent.
+// On the SPI port SPDR is written every 18 cycles (a byte takes 16 at
+// osc/2) by straight-line code, without polling SPIF. When both bytes
+// of the color are equal (BLACK, WHITE, ...) it is a plain byte loop.
+// At a slower SCK that timing would overwrite SPDR mid-byte (WCOL),
+// so the bytes are polled out one by one instead.
+{
+	byte hi = data >> 8, lo = data & 0xFF;
+	if (!count) return;
+#ifdef TFT_MONO_FB
+	if (monoActive)
+	{
+		MonoPixels(data,count);
+		return;
+	}
+#endif
+	if (pix444)
+	{
+		Stream444(Color444(data),count);
+		return;
+	}
+	StatData(2*count);
+#ifndef TFT_USART_SPI  // USART MSPIM polls its buffer at any rate
+	if (SpiByteCycles() != 16)  // not osc/2: no timed kernel
+	{
+		for (; count>0; count--)
+		{
+			Xfer(hi);
+			Xfer(lo);
+		}
+		return;
+	}
+#endif
+#ifdef SpiStream
+	if (hi == lo)
+		for (count*=2; count>0; count--)
+		{
+			SpiStream(hi);
+		}
+	else
+		for (; count>0; count--)
+		{
+			SpiStream(hi);  // write hi byte
+			SpiStream(lo);  // write lo byte
+		}
+#else
+	if (hi == lo)
+	{
+		count *= 2;  // byte count
+		asm volatile(
+			"1:\n\t"
+			"out %[spdr],%[hi]\n\t"  // 1 cycle
+			"subi %A[n],1\n\t"  // 4: 32-bit count down
+			"sbci %B[n],0\n\t"
+			"sbci %C[n],0\n\t"
+			"sbci %D[n],0\n\t"
+			"rjmp .+0\n\t"  // 11: pad to 18 cycles per byte
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"nop\n\t"
+			"brne 1b\n\t"  // 2
+			: [n] "+d" (count)
+			: [spdr] "I" (_SFR_IO_ADDR(SPDR)), [hi] "r" (hi)
+		);
+	}
+	else
+		asm volatile(
+			"1:\n\t"
+			"out %[spdr],%[hi]\n\t"  // 1 cycle
+			"rjmp .+0\n\t"  // 17: pad to 18 cycles
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"nop\n\t"
+			"out %[spdr],%[lo]\n\t"  // 1
+			"subi %A[n],1\n\t"  // 4: 32-bit count down
+			"sbci %B[n],0\n\t"
+			"sbci %C[n],0\n\t"
+			"sbci %D[n],0\n\t"
+			"rjmp .+0\n\t"  // 11
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"nop\n\t"
+			"brne 1b\n\t"  // 2
+			: [n] "+d" (count)
+			: [spdr] "I" (_SFR_IO_ADDR(SPDR)), [hi] "r" (hi), [lo] "r" (lo)
+		);
+	__builtin_avr_delay_cycles(16);  // let the last byte finish
+	SpiWait();  // SPIF is set: reading SPSR and then SPDR clears it,
+	SpiIn();  // so the next Xfer really waits for its own byte
+#endif
+}
+void StreamPixels (int *pixels, unsigned int count)
+// send count RGB565 pixels from RAM, RAMWR already sent
+{
+#ifdef TFT_MONO_FB
+	if (monoActive)
+	{
+		for (; count>0; count--, pixels++)
+			MonoPixels(*pixels,1);
+		return;
+	}
+#endif
+	if (pix444)
+	{
+		for (; count>0; count--, pixels++)
+			Stream444(Color444(*pixels),1);
+		return;
+	}
+	StatData(2L*count);
+	for (; count>0; count--, pixels++)
+	{
+		SpiOut(*pixels >> 8);  // write hi byte
+		SpiWait();
+		SpiOut(*pixels & 0xFF);  // write lo byte
+		SpiWait();
+	}
+}
+void Stream444 (int data, unsigned long count)
+// 12-bit fill kernel: pairs of pixels go out as 3 bytes, RGBR GBRG BRGB...
+// with the same 18-cycle spacing as Stream565, polled below osc/2
+{
+	if (!count) return;
+	if (pixStart)
+	{
+		pixFirst = data;
+		pixStart = 0;
+	}
+	if (pixOdd)  // complete the pair started by the previous call
+	{
+		pixOdd = 0;
+		StatData(3);
+		Xfer(pixHalf >> 4);
+		Xfer(((pixHalf & 0x0F) << 4) | (data >> 8));
+		Xfer(data & 0xFF);
+		count--;
+		if (pixLeft) pixLeft--;
+	}
+	unsigned long pairs = count/2;
+	byte a = data >> 4, b = ((data & 0x0F) << 4) | (data >> 8), c = data & 0xFF;
+	StatData(3*pairs);
+	if (pixLeft) pixLeft -= pixLeft < 2*pairs ? pixLeft : 2*pairs;
+#ifndef TFT_USART_SPI
+	if (SpiByteCycles() != 16)  // not osc/2: no timed kernel
+		for (; pairs>0; pairs--)
+		{
+			Xfer(a);
+			Xfer(b);
+			Xfer(c);
+		}
+#endif
+#ifdef SpiStream
+	for (; pairs>0; pairs--)
+	{
+		SpiStream(a);
+		SpiStream(b);
+		SpiStream(c);
+	}
+#else
+	while (pairs)
+	{
+		unsigned int n = pairs > 0xFFFF ? 0xFFFF : pairs;
+		pairs -= n;
+		asm volatile(
+			"1:\n\t"
+			"out %[spdr],%[a]\n\t"  // 1 cycle
+			"rjmp .+0\n\t"  // 17: pad to 18 cycles
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"nop\n\t"
+			"out %[spdr],%[b]\n\t"  // 1
+			"rjmp .+0\n\t"  // 17
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"nop\n\t"
+			"out %[spdr],%[c]\n\t"  // 1
+			"sbiw %[n],1\n\t"  // 2
+			"rjmp .+0\n\t"  // 13
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"rjmp .+0\n\t"
+			"nop\n\t"
+			"brne 1b\n\t"  // 2
+			: [n] "+w" (n)
+			: [spdr] "I" (_SFR_IO_ADDR(SPDR)), [a] "r" (a), [b] "r" (b), [c] "r" (c)
+		);
+		__builtin_avr_delay_cycles(16);  // let the last byte finish
+		SpiWait();  // clear SPIF, as after Stream565
+		SpiIn();
+	}
+#endif
+	if (count & 1)  // hold the last pixel for its partner
+	{
+		pixHalf = data;
+		pixOdd = 1;
+		if (pixLeft && !--pixLeft)  // it ends the window
+			Pad444();
+	}
+}
+void Write444 (int data, unsigned long count)
+// send count pixels of one RGB444 color in 12-bit mode
+{
+	WriteCmd(RAMWR);
+	Stream444(data,count);
+}
+void SetColorMode (byte bits)
+// 16 = RGB565 (COLMOD 5), 12 = RGB444 (COLMOD 3)
+{
+	WriteCmd(COLMOD);
+	WriteByte(bits == 12 ? 0x03 : 0x05);
+	pix444 = bits == 12;
+}
+void Write565 (int data, unsigned long count)
 // send 16-bit pixel data to the controller
 // note: inlined spi xfer for optimization
 {
 	WriteCmd(RAMWR);
-	for (;count>0;count--)
+	Stream565(data,count);
+}
+void HardwareReset() //reset tft
+// the controller comes back as at power-on: portrait, RGB565, not
+// scrolling, GRAM unknown. The driver's copies of that state follow,
+// and the clip goes back to the whole screen.
+{
+	PumpWait();  // a queued run must not straddle the reset
+	ResetLow();  // pull TFT reset low
+	_delay_us(10);  // 10uS is the minimum pulse
+	ResetHigh();  // return TFT reset high
+	msDelay(5);  // commands are accepted 5mS after reset
+	InvalidateAddrWindow();  // controller is back to its default window
+	maxX = XMAX; maxY = YMAX;  // and to portrait (MADCTL 0)
+	ClearClip();
+	conRows = 0;  // and out of scroll mode
+	conOfs = 0;
+	pix444 = 0;  // the init sequence selects RGB565
+	pixOdd = 0;  // an unpaired 12-bit pixel went with GRAM
+	pixLeft = 0;
+	TextShadowFill(0);  // what the text cells show is unknown
+}
+// command, parameter count, parameters; INIT_DELAY waits, INIT_END ends
+const byte INIT_SEQUENCE[] PROGMEM =
+{
+	COLMOD, 1, 0x05,  // mode 5 = 16bit pixels (RGB565), set while still asleep
+	INIT_DELAY, 115,  // SLPOUT no sooner than 120mS after reset
+	SLPOUT, 0,  // take display out of sleep mode
+	INIT_DELAY, 5,  // supply and clocks settle before the next command
+	INIT_END
+};
+void SendCommands(const byte *table)
+// run a command table from program memory
+{
+	byte cmd;
+	while ((cmd = pgm_read_byte(table++)) != INIT_END)
 	{
-		SPDR = (data >> 8);  // write hi byte
-		while (!(SPSR & 0x80));  // wait for transfer to complete
-		SPDR = (data & 0xFF);  // write lo byte
-		while (!(SPSR & 0x80));  // wait for transfer to complete
+		byte n = pgm_read_byte(table++);
+		if (cmd == INIT_DELAY)
+		{
+			msDelay(n);
+			continue;
+		}
+		WriteCmd(cmd);
+		while (n--)
+			WriteByte(pgm_read_byte(table++));
 	}
 }
-void HardwareReset() //reset tft
+void InitDisplayNoOn()
+// the display stays off: GRAM holds garbage until the first frame
 {
-	ClearBit(PORTB,6);  // pull TFT reset low
-	msDelay(1);  // 1mS is enough 
-	SetBit(PORTB,6);  // return TFT reset high
-	msDelay(150);  // wait 150mS for reset to finish
+	HardwareReset();  // initialize display controller
+	SendCommands(INIT_SEQUENCE);
 }
 void InitDisplay() //itin tft
 {
-	HardwareReset();  // initialize display controller
-	WriteCmd(SLPOUT);  // take display out of sleep mode
-	msDelay(150);  // wait 150mS for TFT driver circuits
-	WriteCmd(COLMOD);  // select color mode: 
-	WriteByte(0x05);  // mode 5 = 16bit pixels (RGB565)
+	InitDisplayNoOn();
+	DisplayOn();
+}
+void DisplayOn()
+{
 	WriteCmd(DISPON);  // turn display on!
 }
+void InvalidateAddrWindow()
+// forget the cached window: the next SetAddrWindow sends both axes
+{
+	winValid = 0;
+}
 void SetAddrWindow(byte x0, byte y0, byte x1, byte y1) //rectangular area
+// only the axes that differ from the current window are sent.
+// RAMWR always restarts at x0,y0, so a cached window is as good as a new one.
 {
-	WriteCmd(CASET);  // set column range (x0,x1)
-	WriteWord(x0);
-	WriteWord(x1);
-	WriteCmd(RASET);  // set row range (y0,y1)
-	WriteWord(y0);
-	WriteWord(y1);
+#ifdef TFT_MONO_FB
+	if (monoActive)
+	{
+		MonoWindow(x0,y0,x1,y1);
+		return;
+	}
+#endif
+	Pad444();  // may move the window: compare after it
+	byte newX = !winValid || x0 != winX0 || x1 != winX1;
+	byte newY = !winValid || y0 != winY0 || y1 != winY1;
+	if (newX || newY)
+		StatWindow();
+	if (newX)
+	{
+		WriteCmd(CASET);  // set column range (x0,x1)
+		WriteWord(x0);
+		WriteWord(x1);
+		winX0 = x0;
+		winX1 = x1;
+	}
+	if (newY)
+	{
+		WriteCmd(RASET);  // set row range (y0,y1)
+		WriteWord(y0);
+		WriteWord(y1);
+		winY0 = y0;
+		winY1 = y1;
+	}
+	winValid = 1;
 }
 void ClearScreen() //clear screen
 {
+	StatEnter(STAT_CLEAR);
 	SetAddrWindow(0,0,XMAX,YMAX);  // set window to entire display
-	WriteCmd(RAMWR);
-	for (unsigned int i=40960;i>0;--i)  // byte count = 128*160*2
+	Write565(BLACK,(long)XSIZE*YSIZE);  // 20480 pixels, one kernel call
+	TextShadowFill(' ');
+	StatLeave();
+}
+//  ---------------------------------------------------------------------------//  SPI PIXEL PUMP
+#ifdef TFT_PUMP
+PumpRun pumpQueue[PUMP_QUEUE];  // runs waiting to be sent
+volatile byte pumpHead, pumpTail;  // next free slot, run being sent
+volatile byte pumpActive;  // nonzero while the interrupt is sending
+byte pumpStep;  // 0..10: window and RAMWR bytes, 11: first pixel byte, 12: pixels
+unsigned int pumpLeft;  // pixel bytes left in the current run
+byte pumpPhase;  // 12-bit mode: byte of the 3-byte pixel pair
+void PumpNext()
+// send the next queued byte; called when the transmitter can take it
+{
+	PumpRun *run = &pumpQueue[pumpTail];
+	byte b;
+	if (pumpStep < 11)  // CASET x0 x1, RASET y0 y1, RAMWR
+	{
+		switch (pumpStep)
+		{
+			case 0: b = CASET; break;
+			case 2: b = run->x0; break;
+			case 4: b = run->x1; break;
+			case 5: b = RASET; break;
+			case 7: b = run->y0; break;
+			case 9: b = run->y1; break;
+			case 10:
+				b = RAMWR;
+				pumpLeft = pix444 ? 3*((run->count+1)/2) : 2*run->count;  // odd: the extra pixel wraps onto the first
+				pumpPhase = 0;
+				break;
+			default: b = 0; break;  // high bytes of the coordinates
+		}
+		if (pumpStep == 0 || pumpStep == 5 || pumpStep == 10)
+		{
+			SpiDrain();
+			DcCommand();
+		}
+		else if (pumpStep == 1 || pumpStep == 6)
+		{
+			SpiDrain();
+			DcData();
+		}
+		pumpStep++;
+		SpiIrqOut(b);
+		return;
+	}
+	if (pumpStep == 11)  // first pixel byte after RAMWR
+	{
+		SpiDrain();
+		DcData();
+		pumpStep++;
+	}
+	if (pumpLeft && pix444)
 	{
-		SPDR = 0;  // initiate transfer of 0x00
-		while (!(SPSR & 0x80));  // wait for xfer to finish
-	} 
+		int c = Color444(run->color);
+		if (pumpPhase == 0) b = c >> 4;
+		else if (pumpPhase == 1) b = ((c & 0x0F) << 4) | (c >> 8);
+		else b = c & 0xFF;
+		if (++pumpPhase == 3) pumpPhase = 0;
+		SpiIrqOut(b);
+		pumpLeft--;
+		return;
+	}
+	if (pumpLeft)
+	{
+		SpiIrqOut(pumpLeft & 1 ? run->color & 0xFF : run->color >> 8);  // hi byte first
+		pumpLeft--;
+		return;
+	}
+	pumpTail = (pumpTail+1) & (PUMP_QUEUE-1);  // run finished
+	pumpStep = 0;
+	if (pumpTail == pumpHead)
+	{
+		SpiIrqOff();  // queue empty: back to polled transfers
+		pumpActive = 0;
+	}
+	else
+		PumpNext();
+}
+#ifndef TFT_HOST
+ISR(SPI_PUMP_vect)
+{
+	PumpNext();
+}
+#endif
+byte PumpBusy()
+{
+	return pumpActive;
+}
+void PumpWait()
+{
+	while (pumpActive)
+	{
+#ifdef TFT_HOST
+		PumpNext();  // no interrupt: send the queue here
+#endif
+	}
+}
+void PumpQueue (byte x0, byte y0, byte x1, byte y1, int color)
+// queue a filled rectangle; waits only if the queue is full
+{
+	Pad444();  // the pump sends its commands without WriteCmd
+	byte next = (pumpHead+1) & (PUMP_QUEUE-1);
+	while (next == pumpTail && pumpActive)  // queue full
+	{
+#ifdef TFT_HOST
+		PumpNext();
+#endif
+	}
+	PumpRun *run = &pumpQueue[pumpHead];
+	run->x0 = x0; run->y0 = y0;
+	run->x1 = x1; run->y1 = y1;
+	run->color = color;
+	run->count = (x1-x0+1) * (y1-y0+1);
+	StatWindow();  // the pump always sends the full window
+	StatCmd(CASET); StatData(4);
+	StatCmd(RASET); StatData(4);
+	StatCmd(RAMWR); StatData(pix444 ? 3L*((run->count+1)/2) : 2L*run->count);
+	winX0 = x0; winX1 = x1;  // the window the controller will end up with
+	winY0 = y0; winY1 = y1;
+	winValid = 1;
+	cli();
+	pumpHead = next;
+	if (!pumpActive)  // idle: send the first byte, the interrupt does the rest
+	{
+		pumpActive = 1;
+		pumpStep = 0;
+		SpiIrqOn();
+		PumpNext();
+	}
+	sei();
+}
+#endif
+void FillRectAsync (byte x0, byte y0, byte x1, byte y1, int color)
+// fill a rectangle, queued to the pump if SCK is slow enough
+{
+	StatEnter(STAT_FILLRECT);
+#ifdef TFT_PUMP
+#ifdef TFT_MONO_FB
+	if (!monoActive)  // the framebuffer has nothing to overlap with
+#endif
+	if (SpiByteCycles() >= PUMP_MIN_CYCLES)
+	{
+		PumpQueue(x0,y0,x1,y1,color);
+		StatLeave();
+		return;
+	}
+#endif
+	SetAddrWindow(x0,y0,x1,y1);  // unclipped, like the pump
+	Write565(color,(long)(x1-x0+1)*(y1-y0+1));
+	StatLeave();
+}
+void ClearScreenAsync()
+// clear the screen, queued to the pump if SCK is slow enough
+{
+	StatEnter(STAT_CLEAR);
+	FillRectAsync(0,0,XMAX,YMAX,BLACK);
+	TextShadowFill(' ');
+	StatLeave();
+}
+//  ---------------------------------------------------------------------------//  1BPP FRAMEBUFFER
+#ifdef TFT_MONO_FB
+byte monoActive;
+byte monoFb[MONO_BYTES], monoShown[MONO_BYTES];  // drawn, and what the panel shows
+byte monoTouched[YSIZE/8];  // one bit per row drawn into since the last flush
+int monoFg, monoBg;
+byte monoX0, monoY0, monoX1, monoY1;  // window
+int monoX, monoY;  // write pointer
+void MonoBegin (int fg, int bg)
+// draw into the framebuffer from now on; the panel is taken to show bg
+{
+	memset(monoFb,0,sizeof(monoFb));
+	memset(monoShown,0,sizeof(monoShown));
+	memset(monoTouched,0,sizeof(monoTouched));
+	monoFg = fg;
+	monoBg = bg;
+	monoActive = 1;
+}
+void MonoWindow (byte x0, byte y0, byte x1, byte y1)
+// SetAddrWindow in framebuffer mode
+{
+	monoX0 = x0; monoY0 = y0;
+	monoX1 = x1; monoY1 = y1;
 }
+void MonoRamwr()
+// RAMWR in framebuffer mode: the write pointer restarts at the window origin
+{
+	monoX = monoX0;
+	monoY = monoY0;
+}
+void MonoSpan (int y, int a, int b, byte on)
+// set (on) or clear pixels a..b of row y
+{
+	byte stride = (maxX+1)/8;
+	if (y > maxY || a > maxX) return;  // off the panel, like the GRAM
+	if (b > maxX) b = maxX;
+	byte *p = &monoFb[y*stride + a/8];
+	byte *last = &monoFb[y*stride + b/8];
+	byte first = 0xFF >> (a & 7), end = 0xFF << (7 - (b & 7));  // edge masks
+	if (p == last)
+		first &= end;
+	*p = on ? *p | first : *p & ~first;
+	if (p != last)
+	{
+		while (++p < last)
+			*p = on ? 0xFF : 0x00;
+		*p = on ? *p | end : *p & ~end;
+	}
+	monoTouched[y >> 3] |= 1 << (y & 7);
+}
+void MonoPixels (int color, unsigned long count)
+// count pixels of color at the write pointer, which runs through the
+// window row by row and wraps like the controller's
+{
+	byte on = color != monoBg;
+	while (count)
+	{
+		unsigned long n = monoX1 - monoX + 1;  // rest of this window row
+		if (n > count) n = count;
+		MonoSpan(monoY,monoX,monoX+n-1,on);
+		count -= n;
+		monoX += n;
+		if (monoX > monoX1)
+		{
+			monoX = monoX0;
+			if (++monoY > monoY1)
+				monoY = monoY0;
+		}
+	}
+}
+byte MonoChanged (int y, byte *lo, byte *hi)
+// byte columns lo..hi of row y that differ from the panel; 0 if none
+{
+	byte stride = (maxX+1)/8;
+	byte *fb = &monoFb[y*stride], *shown = &monoShown[y*stride];
+	if (!(monoTouched[y >> 3] & (1 << (y & 7))))
+		return 0;
+	*lo = 0;
+	*hi = stride-1;
+	while (*lo < stride && fb[*lo] == shown[*lo]) (*lo)++;
+	if (*lo == stride) return 0;
+	while (fb[*hi] == shown[*hi]) (*hi)--;
+	return 1;
+}
+void MonoFlush()
+// send the changed byte columns of the changed rows, one window for
+// every run of changed rows, as fg/bg pixel runs
+{
+	byte stride = (maxX+1)/8, lo, hi, l, h;
+	byte active = monoActive;  // restored on exit: a flush after MonoEnd leaves drawing direct
+	StatEnter(STAT_MONO);
+	monoActive = 0;  // the window and pixels go to the panel now
+	for (int y=0; y<=maxY; )
+	{
+		if (!MonoChanged(y,&lo,&hi))
+		{
+			y++;
+			continue;
+		}
+		int ye = y;  // last row of the run
+		while (ye < maxY && MonoChanged(ye+1,&l,&h))
+		{
+			if (l < lo) lo = l;
+			if (h > hi) hi = h;
+			ye++;
+		}
+		SetAddrWindow(lo*8,y,hi*8+7,ye);
+		WriteCmd(RAMWR);
+		for (; y<=ye; y++)
+		{
+			byte *fb = &monoFb[y*stride];
+			int run = 0;
+			byte bit = fb[lo] & 0x80;  // color of the current run
+			for (int x=lo*8; x<=hi*8+7; x++)
+			{
+				byte b = fb[x/8] & (0x80 >> (x & 7)) ? 0x80 : 0;
+				if (b != bit)
+				{
+					Stream565(bit ? monoFg : monoBg,run);
+					bit = b;
+					run = 0;
+				}
+				run++;
+			}
+			Stream565(bit ? monoFg : monoBg,run);
+			memcpy(&monoShown[y*stride+lo],&fb[lo],hi-lo+1);
+		}
+	}
+	memset(monoTouched,0,sizeof(monoTouched));
+	monoActive = active;
+	StatLeave();
+}
+void MonoEnd()
+// flush and draw to the panel directly again
+{
+	MonoFlush();
+	monoActive = 0;
+}
+#endif
 //  ---------------------------------------------------------------------------//  SIMPLE GRAPHICS ROUTINES
 //
 // note: many routines have byte parameters, to save space,
 // but these can easily be changed to int params for larger displays.
+void SetClip (byte x0, byte y0, byte x1, byte y1)
+// limit clipped drawing to x0..x1, y0..y1
+{
+	clipX0 = x0; clipY0 = y0;
+	clipX1 = x1 < maxX ? x1 : maxX;
+	clipY1 = y1 < maxY ? y1 : maxY;
+}
+void ClearClip()
+// drawing allowed on the whole screen again
+{
+	SetClip(0,0,maxX,maxY);
+}
 void DrawPixel (byte x, byte y, int color) //draw the pixel
 {
+	if (x < clipX0 || x > clipX1 || y < clipY0 || y > clipY1) return;
+	StatEnter(STAT_PIXEL);
 	SetAddrWindow(x,y,x,y);
 	Write565(color,1);
+	StatLeave();
+}
+void DrawPointRuns (Point *points, unsigned int n, int color, byte byColumn)
+// draw n points in one color. The points are binned in place by blocks
+// of POINT_BLOCK rows (columns if byColumn), then each block is marked
+// in a bitmap and sent row by row: duplicates are dropped and
+// neighbours along the row go out as one run. Only one axis of the
+// window changes between runs of a row (column), so SetAddrWindow sends
+// just CASET (RASET) for them. Points off the screen fall in the last
+// bin, which is never drawn.
+{
+	unsigned int next[POINT_BINS+1], end[POINT_BINS+1];
+	byte bits[POINT_BLOCK][YSIZE/8];  // one block; YSIZE is the longer side
+	byte lo = byColumn ? clipY0 : clipX0, hi = byColumn ? clipY1 : clipX1;
+	byte first = byColumn ? clipX0 : clipY0, last = byColumn ? clipX1 : clipY1;
+	StatEnter(STAT_PIXELS);
+	for (byte b=0; b<=POINT_BINS; b++)
+		end[b] = 0;
+	for (unsigned int i=0; i<n; i++)
+	{
+		byte major = byColumn ? points[i].x : points[i].y;
+		end[major < POINT_BINS*POINT_BLOCK ? major/POINT_BLOCK : POINT_BINS]++;
+	}
+	for (unsigned int b=0, start=0; b<=POINT_BINS; b++)
+	{
+		next[b] = start;
+		start += end[b];
+		end[b] = start;
+	}
+	for (byte b=0; b<=POINT_BINS; b++)  // in place: swap each point into its bin
+		while (next[b] < end[b])
+		{
+			Point p = points[next[b]];
+			byte major = byColumn ? p.x : p.y;
+			byte k = major < POINT_BINS*POINT_BLOCK ? major/POINT_BLOCK : POINT_BINS;
+			if (k != b)
+			{
+				points[next[b]] = points[next[k]];
+				points[next[k]++] = p;
+			}
+			else
+				next[b]++;
+		}
+	CpuCycles((unsigned long)n*BIN_POINT_CYCLES);
+	for (byte b=0; b<POINT_BINS && b*POINT_BLOCK <= last; b++)
+	{
+		if (b*POINT_BLOCK+POINT_BLOCK-1 < first || end[b] == (b ? end[b-1] : 0))  // nothing to draw
+			continue;
+		memset(bits,0,sizeof(bits));
+		for (unsigned int i = b ? end[b-1] : 0; i<end[b]; i++)
+		{
+			byte major = byColumn ? points[i].x : points[i].y, minor = byColumn ? points[i].y : points[i].x;
+			if (minor <= YMAX)
+				bits[major%POINT_BLOCK][minor/8] |= 1 << (minor%8);
+		}
+		for (byte l=0; l<POINT_BLOCK; l++)
+		{
+			byte major = b*POINT_BLOCK+l;
+			if (major < first || major > last)
+				continue;
+			CpuCycles((unsigned long)(hi/8-lo/8+1)*BIN_BYTE_CYCLES);
+			for (int m=lo; m<=hi; )
+			{
+				if (!bits[l][m/8] && !(m%8))  // nothing in these 8
+				{
+					m += 8;
+					continue;
+				}
+				CpuCycles(BIN_BIT_CYCLES);
+				if (!(bits[l][m/8] & 1 << (m%8)))
+				{
+					m++;
+					continue;
+				}
+				byte m0 = m;
+				while (m < hi && bits[l][(m+1)/8] & 1 << ((m+1)%8))
+				{
+					CpuCycles(BIN_BIT_CYCLES);
+					m++;
+				}
+				if (byColumn)
+					SetAddrWindow(major,m0,major,m);
+				else
+					SetAddrWindow(m0,major,m,major);
+				Write565(color,m-m0+1);
+				m++;
+			}
+		}
+	}
+	StatLeave();
+}
+void DrawPixels (Point *points, unsigned int n, int color)
+// scatter plot: points binned by row, horizontal neighbours merged
+{
+	DrawPointRuns(points,n,color,0);
+}
+void DrawPixelsColumns (Point *points, unsigned int n, int color)
+// the same binned by column, vertical neighbours merged
+{
+	DrawPointRuns(points,n,color,1);
 }
 void HLine (byte x0, byte x1, byte y, int color)
 // draws a horizontal line in given color
 {
+	StatEnter(STAT_HLINE);
 	byte width = x1-x0+1;
 	SetAddrWindow(x0,y,x1,y);
 	Write565(color,width);
+	StatLeave();
 }
 void VLine (byte x, byte y0, byte y1, int color)
 // draws a vertical line in given color
 {
+	StatEnter(STAT_VLINE);
 	byte height = y1-y0+1;
 	SetAddrWindow(x,y0,x,y1);
 	Write565(color,height);
+	StatLeave();
+}
+void HSpan (int x0, int x1, int y, int color)
+// draws a horizontal run from x0 to x1 (either order), clipped
+{
+	if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+	if (y < clipY0 || y > clipY1 || x1 < clipX0 || x0 > clipX1) return;
+	if (x0 < clipX0) x0 = clipX0;
+	if (x1 > clipX1) x1 = clipX1;
+	HLine(x0,x1,y,color);
+}
+void VSpan (int x, int y0, int y1, int color)
+// draws a vertical run from y0 to y1 (either order), clipped
+{
+	if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+	if (x < clipX0 || x > clipX1 || y1 < clipY0 || y0 > clipY1) return;
+	if (y0 < clipY0) y0 = clipY0;
+	if (y1 > clipY1) y1 = clipY1;
+	VLine(x,y0,y1,color);
 }
 void Line (int x0, int y0, int x1, int y1, int color)
 // an elegant implementation of the Bresenham algorithm 
+// Pixels are collected into runs along the major axis, and each run
+// goes out as one address window instead of one window per pixel.
 {
+	StatEnter(STAT_LINE);
 	int dx = abs(x1-x0), sx = x0<x1 ? 1 : -1;
 	int dy = abs(y1-y0), sy = y0<y1 ? 1 : -1;
 	int err = (dx>dy ? dx : -dy)/2, e2;
+	int rx = x0, ry = y0;  // first pixel of the current run
 	for(;;) 
 	{
-		DrawPixel(x0,y0,color);
 		if (x0==x1 && y0==y1) break;
 		e2 = err;
-		if (e2 >-dx) { err -= dy; x0 += sx; }
-		if (e2 < dy) { err += dx; y0 += sy; }
+		int nx = x0, ny = y0;
+		if (e2 >-dx) { err -= dy; nx += sx; }
+		if (e2 < dy) { err += dx; ny += sy; }
+		if (dx > dy ? ny != y0 : nx != x0)  // next pixel leaves the run
+		{
+			if (dx > dy) HSpan(rx,x0,y0,color);
+			else VSpan(x0,ry,y0,color);
+			rx = nx; ry = ny;
+		}
+		x0 = nx; y0 = ny;
 	}
+	if (dx > dy) HSpan(rx,x0,y0,color);  // last run ends at x1,y1
+	else VSpan(x0,ry,y0,color);
+	StatLeave();
 }
 void DrawRect (byte x0, byte y0, byte x1, byte y1, int color)
 // draws a rectangle in given color
 {
+	StatEnter(STAT_RECT);
 	HLine(x0,x1,y0,color);
 	HLine(x0,x1,y1,color);
 	VLine(x0,y0,y1,color);
 	VLine(x1,y0,y1,color);
+	StatLeave();
 }
 void FillRect (byte x0, byte y0, byte x1, byte y1, int color) //filled rectangular
 {
+	if (x0 < clipX0) x0 = clipX0;
+	if (y0 < clipY0) y0 = clipY0;
+	if (x1 > clipX1) x1 = clipX1;
+	if (y1 > clipY1) y1 = clipY1;
+	if (x0 > x1 || y0 > y1) return;  // outside the clip rectangle
+	StatEnter(STAT_FILLRECT);
 	byte width = x1-x0+1;
 	byte height = y1-y0+1;
 	SetAddrWindow(x0,y0,x1,y1);
 	Write565(color,width*height);
+	StatLeave();
+}
+void OctantRuns (int xl, int yt, int xr, int yb, int h, int a, int b, byte octants, int color)
+// sends one run of the circle walk in every selected octant.
+// The run covers offsets a..b at distance h from the centre. Left and right
+// halves are centred on xl and xr, top and bottom halves on yt and yb, so a
+// rounded rectangle gets its straight sides from the first run (a=0).
+// Where two neighbouring octants are both selected their runs are merged.
+{
+	int v = (b == h) ? b-1 : b;  // the 45-degree pixel belongs to the horizontal runs
+	if (a == 0 && (octants & 0x06) == 0x06)  // top: octants 1+2
+		HSpan(xl-b,xr+b,yt-h,color);
+	else
+	{
+		if (octants & 0x02) HSpan(xr+a,xr+b,yt-h,color);
+		if (octants & 0x04) HSpan(xl-b,xl-a,yt-h,color);
+	}
+	if (h == 0 && yt == yb)  // radius 0: top and bottom are the same row
+		return;
+	if (a == 0 && (octants & 0x60) == 0x60)  // bottom: octants 5+6
+		HSpan(xl-b,xr+b,yb+h,color);
+	else
+	{
+		if (octants & 0x20) HSpan(xl-b,xl-a,yb+h,color);
+		if (octants & 0x40) HSpan(xr+a,xr+b,yb+h,color);
+	}
+	if (a == 0 && (octants & 0x81) == 0x81)  // right: octants 7+0
+	{
+		if (yt-v <= yb+v) VSpan(xr+h,yt-v,yb+v,color);
+	}
+	else if (v >= a)
+	{
+		if (octants & 0x01) VSpan(xr+h,yt-v,yt-a,color);
+		if (octants & 0x80) VSpan(xr+h,yb+a,yb+v,color);
+	}
+	if (h == 0 && xl == xr)  // radius 0, no width: left and right are the same column
+		return;
+	if (a == 0 && (octants & 0x18) == 0x18)  // left: octants 3+4
+	{
+		if (yt-v <= yb+v) VSpan(xl-h,yt-v,yb+v,color);
+	}
+	else if (v >= a)
+	{
+		if (octants & 0x08) VSpan(xl-h,yt-v,yt-a,color);
+		if (octants & 0x10) VSpan(xl-h,yb+a,yb+v,color);
+	}
+}
+void RoundOutline (int xl, int yt, int xr, int yb, byte radius, byte octants, int color)
+// midpoint circle walk over one octant, no square roots.
+// Pixels that share a row (near the top) or a column (near the side)
+// are collected into runs and sent by OctantRuns.
+{
+	int x = 0, y = radius, d = 1 - radius;
+	int a = 0;  // first offset of the current run
+	while (x <= y)
+	{
+		int ny = y;
+		if (d < 0) d += 2*x + 3;
+		else { d += 2*(x-y) + 5; ny--; }
+		if (ny != y || x+1 > ny)  // next pixel starts a new run
+		{
+			OctantRuns(xl,yt,xr,yb,y,a,x,octants,color);
+			a = x+1;
+		}
+		x++;
+		y = ny;
+	}
+}
+void Arc (byte xPos, byte yPos, byte radius, byte octants, int color)
+// draws the 45-degree arcs selected by octants, centered at x,y.
+// bit n covers n*45 to (n+1)*45 degrees, counterclockwise from 3 o'clock:
+// bit 0: 0-45 (right, upper half)   bit 4: 180-225 (left, lower half)
+// bit 1: 45-90 (top, right half)    bit 5: 225-270 (bottom, left half)
+// bit 2: 90-135 (top, left half)    bit 6: 270-315 (bottom, right half)
+// bit 3: 135-180 (left, upper half) bit 7: 315-360 (right, lower half)
+{
+	StatEnter(STAT_CIRCLE);
+	RoundOutline(xPos,yPos,xPos,yPos,radius,octants,color);
+	StatLeave();
 }
 void CircleQuadrant (byte xPos, byte yPos, byte radius, byte quad, int color)
 // draws circle quadrant(s) centered at x,y with given radius & color
@@ -387,68 +1399,78 @@ void CircleQuadrant (byte xPos, byte yPos, byte radius, byte quad, int color)
 // bit 2: draw quadrant II (lower left)
 // bit 3: draw quadrant III (upper left)
 {
-	int x, xEnd = (707*radius)/1000 + 1;
-	for (x=0; x<xEnd; x++)
-	{
-		byte y = intsqrt(radius*radius - x*x);
-		if (quad & 0x01)
-		{
-			DrawPixel(xPos+x,yPos+y,color);  // lower right
-			DrawPixel(xPos+y,yPos+x,color);
-		}
-		if (quad & 0x02)
-		{
-			DrawPixel(xPos+x,yPos-y,color);  // upper right
-			DrawPixel(xPos+y,yPos-x,color);
-		}
-		if (quad & 0x04)
-		{
-			DrawPixel(xPos-x,yPos+y,color);  // lower left
-			DrawPixel(xPos-y,yPos+x,color);
-		}
-		if (quad & 0x08)
-		{
-			DrawPixel(xPos-x,yPos-y,color);  // upper left
-			DrawPixel(xPos-y,yPos-x,color);
-		}
-	}
+	byte octants = 0;
+	if (quad & 0x01) octants |= 0xC0;  // lower right = octants 6,7
+	if (quad & 0x02) octants |= 0x03;  // upper right = octants 0,1
+	if (quad & 0x04) octants |= 0x30;  // lower left = octants 4,5
+	if (quad & 0x08) octants |= 0x0C;  // upper left = octants 2,3
+	Arc(xPos,yPos,radius,octants,color);
 }
 void Circle (byte xPos, byte yPos, byte radius, int color)
 // draws circle at x,y with given radius & color
 {
-	CircleQuadrant(xPos,yPos,radius,0x0F,color); // do all 4 quadrants
+	Arc(xPos,yPos,radius,0xFF,color); // all 8 octants
 }
 void RoundRect (byte x0, byte y0, byte x1, byte y1, byte r, int color)
 // draws a rounded rectangle with corner radius r.
 // coordinates: top left = x0,y0; bottom right = x1,y1 
+// The corners are one circle split apart, so each side goes out
+// as one run together with the flat top of its corners.
 {
-	HLine(x0+r,x1-r,y0,color);  // top side
-	HLine(x0+r,x1-r,y1,color);  // bottom side
-	VLine(x0,y0+r,y1-r,color);  // left side
-	VLine(x1,y0+r,y1-r,color);  // right side
-	CircleQuadrant(x0+r,y0+r,r,8,color);  // upper left corner
-	CircleQuadrant(x1-r,y0+r,r,2,color);  // upper right corner
-	CircleQuadrant(x0+r,y1-r,r,4,color);  // lower left corner
-	CircleQuadrant(x1-r,y1-r,r,1,color);  // lower right corner
+	StatEnter(STAT_ROUNDRECT);
+	RoundOutline(x0+r,y0+r,x1-r,y1-r,r,0xFF,color);
+	StatLeave();
 }
-void FillCircle (byte xPos, byte yPos, byte radius, int color)
-// draws filled circle at x,y with given radius & color
+void FillRows (int xl, int yt, int xr, int yb, int dy, int half, int color)
+// fills the row dy above yt and the row dy below yb, from xl-half to xr+half.
+// When both are the same row (dy=0 on a circle) it is sent only once.
 {
-	long r2 = radius * radius;
-	for (int x=0; x<=radius; x++)
+	HSpan(xl-half,xr+half,yt-dy,color);
+	if (yb+dy != yt-dy)
+		HSpan(xl-half,xr+half,yb+dy,color);
+}
+void RoundFill (int xl, int yt, int xr, int yb, byte radius, int color)
+// scanline fill of a circle split at xl..xr and yt..yb (see RoundOutline).
+// The midpoint walk gives the half-width of every row incrementally;
+// each row is sent exactly once, as one span.
+{
+	int x = 0, y = radius, d = 1 - radius;
+	while (x <= y)
 	{
-		byte y = intsqrt(r2-x*x);
-		byte y0 = yPos-y;
-		byte y1 = yPos+y;
-		VLine(xPos+x,y0,y1,color);
-		VLine(xPos-x,y0,y1,color);
+		int ny = y;
+		if (d < 0) d += 2*x + 3;
+		else { d += 2*(x-y) + 5; ny--; }
+		if (x < y)
+			FillRows(xl,yt,xr,yb,x,y,color);  // row at distance x is y wide
+		if (ny != y || x+1 > ny)  // last pixel on row y: its width is known
+			FillRows(xl,yt,xr,yb,y,x,color);
+		x++;
+		y = ny;
 	}
 }
+void FillCircle (byte xPos, byte yPos, byte radius, int color)
+// draws filled circle at x,y with given radius & color
+{
+	StatEnter(STAT_FILLCIRCLE);
+	RoundFill(xPos,yPos,xPos,yPos,radius,color);
+	StatLeave();
+}
+void FillRoundRect (byte x0, byte y0, byte x1, byte y1, byte r, int color)
+// draws a filled rounded rectangle with corner radius r.
+// coordinates: top left = x0,y0; bottom right = x1,y1 
+{
+	StatEnter(STAT_FILLROUNDRECT);
+	RoundFill(x0+r,y0+r,x1-r,y1-r,r,color);  // rounded top and bottom rows
+	if (y0+r+1 <= y1-r-1)
+		FillRect(x0,y0+r+1,x1,y1-r-1,color);  // straight middle in one window
+	StatLeave();
+}
 void Ellipse (int x0, int y0, int width, int height, int color)
 // draws an ellipse of given width & height
 // two-part Bresenham method
 // note: slight discontinuity between parts on some (narrow) ellipses.
 {
+	StatEnter(STAT_ELLIPSE);
 	int a=width/2, b=height/2;
 	int x = 0, y = b;
 	long a2 = (long)a*a*2;
@@ -489,27 +1511,338 @@ void Ellipse (int x0, int y0, int width, int height, int color)
 			stopY -= b2;
 		}
 	}
+	StatLeave();
 } 
 void FillEllipse(int xPos,int yPos,int width,int height, int color)
 // draws a filled ellipse of given width & height
+// Each row is as wide as the inside test b2*x*x + a2*y*y <= a2*b2 allows.
+// The half-width only shrinks going out from the centre, so it is walked
+// down once (no search per row), and each pair of rows goes out as two spans.
 {
+	StatEnter(STAT_FILLELLIPSE);
 	int a=width/2, b=height/2;  // get x & y radii
-	int x1, x0 = a, y = 1, dx = 0;
-	long a2 = a*a, b2 = b*b;  // need longs: big numbers!
+	long a2 = (long)a*a, b2 = (long)b*b;  // need longs: big numbers!
 	long a2b2 = a2 * b2;
-	HLine(xPos-a,xPos+a,yPos,color);  // draw centerline
-	while (y<=b)  // draw horizontal lines...
+	int x = a;  // half-width of the row
+	for (int y=0; y<=b; y++)
+	{
+		while (x > 0 && b2*x*x + a2*y*y > a2b2)
+			x--;
+		FillRows(xPos,yPos,xPos,yPos,y,x,color);
+	}
+	StatLeave();
+}
+//  ---------------------------------------------------------------------------//  PIXEL STREAMS
+byte streamX0, streamY0, streamX1, streamY1;  // the open window
+byte streamX, streamY;  // next pixel of the window
+byte streamClipped;  // nonzero if part of the window is outside the clip
+byte streamCX0, streamCY0, streamCX1, streamCY1;  // part inside the clip
+void BeginWindow (byte x0, byte y0, byte x1, byte y1)
+// open x0,y0..x1,y1 for streaming, from its top left pixel
+{
+	StatEnter(STAT_STREAM);
+	streamX0 = x0; streamY0 = y0;
+	streamX1 = x1; streamY1 = y1;
+	streamX = x0; streamY = y0;
+	streamCX0 = x0 > clipX0 ? x0 : clipX0;
+	streamCY0 = y0 > clipY0 ? y0 : clipY0;
+	streamCX1 = x1 < clipX1 ? x1 : clipX1;
+	streamCY1 = y1 < clipY1 ? y1 : clipY1;
+	streamClipped = streamCX0 != x0 || streamCY0 != y0 || streamCX1 != x1 || streamCY1 != y1;
+	if (streamCX0 > streamCX1 || streamCY0 > streamCY1)  // nothing visible
+	{
+		streamCY0 = 1; streamCY1 = 0;  // no row passes the clip test
+		return;
+	}
+	SetAddrWindow(streamCX0,streamCY0,streamCX1,streamCY1);
+	WriteCmd(RAMWR);
+}
+void PushRun (int *pixels, int color, unsigned long count)
+// stream count pixels, from pixels or of one color if pixels is 0,
+// sending only the ones inside the clip rectangle
+{
+	if (!streamClipped)  // the window is the RAMWR window
+	{
+		if (pixels)
+			StreamPixels(pixels,count);
+		else
+			Stream565(color,count);
+		return;
+	}
+	while (count)
+	{
+		unsigned long n = streamX1 - streamX + 1;  // rest of the row
+		if (n > count) n = count;
+		int a = streamX > streamCX0 ? streamX : streamCX0;  // visible part
+		int b = streamX+n-1 < streamCX1 ? streamX+n-1 : streamCX1;
+		if (streamY >= streamCY0 && streamY <= streamCY1 && a <= b)
+		{
+			if (pixels)
+				StreamPixels(pixels + (a-streamX),b-a+1);
+			else
+				Stream565(color,b-a+1);
+		}
+		if (pixels)
+			pixels += n;
+		count -= n;
+		if (streamX+n > streamX1)  // row done
+		{
+			streamX = streamX0;
+			streamY = streamY < streamY1 ? streamY+1 : streamY0;  // wraps like the controller
+		}
+		else
+			streamX += n;
+	}
+}
+void PushPixels (int *pixels, unsigned int count)
+// stream count RGB565 pixels from RAM
+{
+	PushRun(pixels,0,count);
+}
+void PushColor (int color, unsigned long count)
+// stream count pixels of one color
+{
+	PushRun(0,color,count);
+}
+void EndWindow()
+// close the stream
+{
+	Pad444();  // a 12-bit window left short on an odd pixel sends it now
+	StatLeave();
+}
+void StreamWindow (byte x0, byte y0, byte x1, byte y1, PixelSource source)
+// fill a window with the colors source returns, clipped rows and
+// columns are never asked for
+{
+	int chunk[STREAM_CHUNK];
+	BeginWindow(x0,y0,x1,y1);
+	for (int y=streamCY0; y<=streamCY1; y++)
+		for (int x=streamCX0; x<=streamCX1; x+=STREAM_CHUNK)
+		{
+			byte n = streamCX1-x+1 < STREAM_CHUNK ? streamCX1-x+1 : STREAM_CHUNK;
+			source(x,y,n,chunk);
+			StreamPixels(chunk,n);
+		}
+	EndWindow();
+}
+//  ---------------------------------------------------------------------------//  COMPOSITOR
+int RoundHalf (byte radius, byte dy)
+// half-width of row dy from the centre, as RoundFill draws it:
+// the same midpoint walk, stopped at the row asked for
+{
+	int x = 0, y = radius, d = 1 - radius;
+	while (x <= y)
+	{
+		int ny = y;
+		CpuCycles(ROUND_STEP_CYCLES);
+		if (d < 0) d += 2*x + 3;
+		else { d += 2*(x-y) + 5; ny--; }
+		if (x < y && x == dy)
+			return y;
+		if ((ny != y || x+1 > ny) && y == dy)
+			return x;
+		x++;
+		y = ny;
+	}
+	return -1;  // dy beyond the radius
+}
+#ifdef TFT_COMPOSITE
+CompositeItem compItems[COMPOSITE_ITEMS];
+byte compCount;  // queued shapes
+void CompositeBegin()
+// start queueing shapes
+{
+	compCount = 0;
+}
+void CompositeAdd (CompositeItem *item)
+// queue a shape, committing a full queue first
+{
+	if (compCount == COMPOSITE_ITEMS)
+		CompositeCommit();
+	compItems[compCount++] = *item;
+}
+void CompositeFillRect (byte x0, byte y0, byte x1, byte y1, int color)
+// queue a filled rectangle
+{
+	CompositeItem item = { 0, x0, y0, x1, y1, color };
+	CompositeAdd(&item);
+}
+void CompositeFillCircle (byte xPos, byte yPos, byte radius, int color)
+// queue a filled circle, same pixels as FillCircle
+{
+	CompositeItem item = { 1, xPos, yPos, radius, 0, color };
+	CompositeAdd(&item);
+}
+void CompositeHLine (byte x0, byte x1, byte y, int color)
+// queue a horizontal line
+{
+	CompositeFillRect(x0,y,x1,y,color);
+}
+byte CompositeSpan (CompositeItem *item, int y, int *a, int *b)
+// span a..b of a queued shape on row y, clipped; 0 if it has none
+{
+	if (y < clipY0 || y > clipY1)
+		return 0;
+	if (item->circle)
+	{
+		int h = RoundHalf(item->x1,abs(y-item->y0));
+		if (h < 0) return 0;
+		*a = item->x0 - h;
+		*b = item->x0 + h;
+	}
+	else
 	{
-		for (x1= x0-(dx-1); x1>0; x1--)
-		if (b2*x1*x1 + a2*y*y <= a2b2)
-		break;
-		dx = x0-x1;
-		x0 = x1;
-		HLine(xPos-x0,xPos+x0,yPos+y,color);
-		HLine(xPos-x0,xPos+x0,yPos-y,color);
-		y += 1;
+		if (y < item->y0 || y > item->y1) return 0;
+		*a = item->x0;
+		*b = item->x1;
 	}
+	if (*a < clipX0) *a = clipX0;
+	if (*b > clipX1) *b = clipX1;
+	return *a <= *b;
 }
+byte CompositeRow (int y, CompositeRun *runs)
+// final-color runs of row y, left to right: each shape's span is laid
+// over the runs of the shapes before it. Returns the number of runs.
+{
+	byte n = 0;
+	for (CompositeItem *item=compItems; item<compItems+compCount; item++)
+	{
+		int a, b;  // span of this shape on row y
+		if (!CompositeSpan(item,y,&a,&b))
+			continue;
+		byte i = 0, j;
+		while (i < n && runs[i].x1 < a)  // runs left of the span stay
+			i++;
+		if (i < n && runs[i].x0 < a)  // run sticks out on the left
+		{
+			if (runs[i].x1 > b)  // span inside one run: split it in three
+			{
+				memmove(&runs[i+2],&runs[i],(n-i)*sizeof(CompositeRun));
+				runs[i+2].x0 = b+1;
+				runs[i].x1 = a-1;
+				runs[i+1].x0 = a; runs[i+1].x1 = b; runs[i+1].color = item->color;
+				n += 2;
+				continue;
+			}
+			runs[i++].x1 = a-1;
+		}
+		for (j=i; j<n && runs[j].x1 <= b; j++)  // runs hidden by the span
+			;
+		if (j < n && runs[j].x0 <= b)  // run sticks out on the right
+			runs[j].x0 = b+1;
+		memmove(&runs[i+1],&runs[j],(n-j)*sizeof(CompositeRun));
+		n = n - (j-i) + 1;
+		runs[i].x0 = a; runs[i].x1 = b; runs[i].color = item->color;
+	}
+	return n;
+}
+byte SameExtents (CompositeRun *a, byte na, CompositeRun *b, byte nb)
+// nonzero if both rows cover the same pixels, whatever their colors
+{
+	byte i = 0, j = 0;
+	while (i < na && j < nb)
+	{
+		if (a[i].x0 != b[j].x0) return 0;
+		while (i+1 < na && a[i+1].x0 == a[i].x1+1) i++;  // to the end of a stretch
+		while (j+1 < nb && b[j+1].x0 == b[j].x1+1) j++;
+		if (a[i].x1 != b[j].x1) return 0;
+		i++; j++;
+	}
+	return i == na && j == nb;
+}
+void CompositeCommit()
+// send the queued shapes: band by band, one window per contiguous stretch
+{
+	CompositeRun runs[COMPOSITE_RUNS], next[COMPOSITE_RUNS];
+	int top = 255, bottom = -1;
+	if (!compCount)
+		return;
+	StatEnter(STAT_COMPOSITE);
+	for (CompositeItem *item=compItems; item<compItems+compCount; item++)
+	{
+		int y0 = item->circle ? item->y0 - item->x1 : item->y0;
+		int y1 = item->circle ? item->y0 + item->x1 : item->y1;
+		if (y0 < top) top = y0;
+		if (y1 > bottom) bottom = y1;
+	}
+	if (top < clipY0) top = clipY0;
+	if (bottom > clipY1) bottom = clipY1;
+	for (int y=top; y<=bottom; )
+	{
+		byte n = CompositeRow(y,runs);
+		int yb = y;  // last row of the band
+		while (yb < bottom)
+		{
+			byte nn = CompositeRow(yb+1,next);
+			if (!SameExtents(runs,n,next,nn)) break;
+			yb++;
+		}
+		for (byte s=0; s<n; )  // every stretch of the band
+		{
+			byte e = s;  // last run of the stretch
+			while (e+1 < n && runs[e+1].x0 == runs[e].x1+1)
+				e++;
+			SetAddrWindow(runs[s].x0,y,runs[e].x1,yb);
+			WriteCmd(RAMWR);
+			for (int row=y; row<=yb; row++)
+			{
+				byte nn = CompositeRow(row,next);
+				for (byte i=0; i<nn; i++)
+					if (next[i].x0 >= runs[s].x0 && next[i].x1 <= runs[e].x1)
+						Stream565(next[i].color,next[i].x1-next[i].x0+1);
+			}
+			s = e+1;
+		}
+		y = yb+1;
+	}
+	compCount = 0;
+	StatLeave();
+}
+#ifdef TFT_BAND_HEIGHT
+int bandBuf[BAND_PIXELS];  // one band of the area being rendered
+void BandCommit (byte x0, byte y0, byte x1, byte y1, int bg)
+// render the queued shapes over bg into x0,y0..x1,y1: each band is
+// rasterized in bandBuf, in queue order, then sent; one RAMWR in all
+{
+	if (x0 < clipX0) x0 = clipX0;
+	if (y0 < clipY0) y0 = clipY0;
+	if (x1 > clipX1) x1 = clipX1;
+	if (y1 > clipY1) y1 = clipY1;
+	if (x0 > x1 || y0 > y1)
+	{
+		compCount = 0;
+		return;
+	}
+	StatEnter(STAT_BAND);
+	byte width = x1-x0+1;
+	int rows = BAND_PIXELS/width;  // rows per band; over 255 when width < 5
+	SetAddrWindow(x0,y0,x1,y1);
+	WriteCmd(RAMWR);
+	for (int y=y0; y<=y1; y+=rows)
+	{
+		byte height = y1-y+1 < rows ? y1-y+1 : rows;
+		unsigned int count = width*height;
+		for (unsigned int i=0; i<count; i++)
+			bandBuf[i] = bg;
+		for (CompositeItem *item=compItems; item<compItems+compCount; item++)
+			for (byte row=0; row<height; row++)
+			{
+				int a, b;
+				if (!CompositeSpan(item,y+row,&a,&b) || b < x0 || a > x1)
+					continue;
+				if (a < x0) a = x0;
+				if (b > x1) b = x1;
+				int *p = &bandBuf[row*width + a-x0];
+				for (int x=a; x<=b; x++)
+					*p++ = item->color;
+			}
+		StreamPixels(bandBuf,count);
+	}
+	compCount = 0;
+	StatLeave();
+}
+#endif
+#endif
 //  ---------------------------------------------------------------------------//  TEXT ROUTINES
 // 
 // Each ASCII character is 5x7, with one pixel space between characters
@@ -525,6 +1858,92 @@ void FillEllipse(int xPos,int yPos,int width,int height, int color)
 // Display height is 128, so there are 16 rows (16x8 = 128).
 // Total number of characters in landscape mode = 26x16 = 416. 
 byte curX,curY;  // current x & y cursor position
+#ifdef TFT_TEXT_SHADOW
+TextCell textShadow[TEXT_CELLS];  // what each character cell shows
+byte TextShadowSet(char ch, byte x, byte y, int color)
+// record ch at cell x,y; returns nonzero if the cell changed
+{
+	if (ch == ' ')
+		color = 0;
+	TextCell *cell = &textShadow[y*TextCols()+x];
+	if (cell->ch == ch && cell->color == color)
+		return 0;
+	cell->ch = ch;
+	cell->color = color;
+	return 1;
+}
+void TextShadowScroll(byte first)
+// move the cell rows below first up one row, blank the last row
+{
+	byte cols = TextCols();
+	memmove(&textShadow[first*cols],&textShadow[(first+1)*cols],
+		(TextRows()-first-1)*cols*sizeof(TextCell));
+	for (TextCell *cell=&textShadow[(TextRows()-1)*cols]; cols>0; cols--, cell++)
+	{
+		cell->ch = ' ';
+		cell->color = 0;
+	}
+}
+void TextShadowFill(char ch)
+// set every cell to ch: ' ' after a clear, 0 for unknown contents
+{
+	for (int i=0; i<TEXT_CELLS; i++)
+	{
+		textShadow[i].ch = ch;
+		textShadow[i].color = 0;
+	}
+}
+#endif
+byte TextCols()
+// characters per row: 21 in portrait, 26 in landscape
+{
+	return (maxX+1)/6;
+}
+byte TextRows()
+// character rows: 20 in portrait, 16 in landscape
+{
+	return (maxY+1)/8;
+}
+byte TextY(byte row)
+// display y of text row: rows in the console area move with the scroll
+{
+	if (!conRows || row < conFixed)
+		return row*8;
+	return conFixed*8 + ((row-conFixed)*8 + conOfs) % (conRows*8);
+}
+void ConsoleBegin(byte fixedRows)
+// scroll the text rows below fixedRows; cursor to the first of them
+{
+	conFixed = fixedRows;
+	conRows = TextRows() - fixedRows;
+	conOfs = 0;
+	WriteCmd(VSCRDEF);
+	WriteWord(conFixed*8);  // top fixed area
+	WriteWord(conRows*8);  // scroll area
+	WriteWord(YSIZE - TextRows()*8);  // bottom fixed area
+	WriteCmd(VSCSAD);
+	WriteWord(conFixed*8);  // no scroll yet
+	GotoLine(conFixed);
+}
+void ConsoleEnd()
+// back to normal display mode, screen cleared
+{
+	WriteCmd(NORON);
+	conRows = 0;
+	ClearScreen();
+}
+void ConsoleScroll()
+// scroll the console up one text row, blanking the new last row
+{
+	byte y = TextY(conFixed);  // top console row, about to become the last
+	FillRect(0,y,XMAX,y+7,BLACK);
+	conOfs += 8;
+	if (conOfs >= conRows*8)
+		conOfs = 0;
+	WriteCmd(VSCSAD);
+	WriteWord(conFixed*8 + conOfs);
+	TextShadowScroll(conFixed);
+}
 void GotoXY (byte x,byte y)
 // position cursor on character x,y grid, where 0<x<20, 0<y<19.
 {
@@ -538,15 +1957,21 @@ void GotoLine(byte y)
 	curY = y;
 }
 void AdvanceCursor()
-// moves character cursor to next position, assuming portrait orientation
+// moves character cursor to next position, wrapping at the margins
+// of the current orientation
 {
 	curX++;  // advance x position
-	if (curX>20)  // beyond right margin?
+	if (curX>=TextCols())  // beyond right margin?
 	{
 		curY++;  // go to next line
 		curX = 0;  // at left margin
 	}
-	if (curY>19)  // beyond bottom margin?
+	if (curY>=TextRows() && conRows)  // console: scroll instead of wrapping
+	{
+		ConsoleScroll();
+		curY = TextRows()-1;
+	}
+	if (curY>=TextRows())  // beyond bottom margin?
 	curY = 0;  // start at top again
 }
 void SetOrientation(int degrees)
@@ -562,41 +1987,140 @@ void SetOrientation(int degrees)
 	}
 	WriteCmd(MADCTL);
 	WriteByte(arg);
+	InvalidateAddrWindow();  // window is now in the new axis order
+	maxX = (arg & 0x20) ? YMAX : XMAX;  // MV swaps rows and columns
+	maxY = (arg & 0x20) ? XMAX : YMAX;
+	ClearClip();
+	TextShadowFill(0);  // cells are laid out differently now
+}
+void FetchGlyph (char ch, byte *cols)
+// copy the 5 column bytes of ch from the font table (bit 0 = top row)
+{
+	int index = (byte)ch - 32;  // font starts at space
+	if (index >= 160)  // Cyrillic follows ASCII 32..127 in the table
+		index -= 64;
+	for (byte col=0; col<5; col++)
+		cols[col] = pgm_read_byte(&(FONT_CHARS[index][col]));
 }
+// one glyph pixel: color where bits has the mask bit, BLACK background elsewhere
+#ifdef TFT_MONO_FB
+#define GLYPH_PIXEL(bits) do { \
+	if (monoActive) MonoPixels((bits) & mask ? color : BLACK,1); \
+	else if (pix444) Stream444((bits) & mask ? c444 : 0,1); \
+	else if ((bits) & mask) { SpiOut(hi); SpiWait(); SpiOut(lo); SpiWait(); } \
+	else { SpiOut(0); SpiWait(); SpiOut(0); SpiWait(); } \
+} while (0)
+#else
+#define GLYPH_PIXEL(bits) do { \
+	if (pix444) Stream444((bits) & mask ? c444 : 0,1); \
+	else if ((bits) & mask) { SpiOut(hi); SpiWait(); SpiOut(lo); SpiWait(); } \
+	else { SpiOut(0); SpiWait(); SpiOut(0); SpiWait(); } \
+} while (0)
+#endif
 void PutCh (char ch, byte x, byte y, int color)
 // write ch to display X,Y coordinates using ASCII 5x7 font
+// note: glyph fetched once, cell streamed in one RAMWR burst
 {
-	int  pixel;
-	byte row, col, bit, data, mask = 0x01;
-	SetAddrWindow(x,y,x+4,y+6);
+	int c0 = clipX0-x, c1 = clipX1-x;  // visible part of the cell
+	int r0 = clipY0-y, r1 = clipY1-y;
+	if (c0 < 0) c0 = 0;
+	if (c1 > 4) c1 = 4;
+	if (r0 < 0) r0 = 0;
+	if (r1 > 6) r1 = 6;
+	if (c0 > c1 || r0 > r1) return;  // outside the clip rectangle
+	StatEnter(STAT_PUTCH);
+	byte cols[5], hi = color >> 8, lo = color & 0xFF;
+	int c444 = Color444(color);
+	FetchGlyph(ch,cols);
+	SetAddrWindow(x+c0,y+r0,x+c1,y+r1);
 	WriteCmd(RAMWR);
-	for (row=0; row<7;row++)
+	if (!pix444)  // Stream444 counts its own bytes
+		StatData(2L*(c1-c0+1)*(r1-r0+1));
+	for (byte mask=1<<r0; mask<=(1<<r1); mask<<=1)  // rows, top down
 	{
-		for (col=0; col<5;col++)
+		if (c0 == 0 && c1 == 4)  // whole row
 		{
-			int nnn = ch - 32;
-			if(nnn >= 160)
-				nnn -= 64;
-			data = pgm_read_byte(&(FONT_CHARS[nnn][col]));
-			bit = data & mask;
-			if (bit==0) pixel=BLACK;
-			else  pixel=color;
-			WriteWord(pixel);
+			GLYPH_PIXEL(cols[0]);
+			GLYPH_PIXEL(cols[1]);
+			GLYPH_PIXEL(cols[2]);
+			GLYPH_PIXEL(cols[3]);
+			GLYPH_PIXEL(cols[4]);
 		}
-		mask <<= 1;
+		else
+			for (byte col=c0; col<=c1; col++)
+			{
+				GLYPH_PIXEL(cols[col]);
+			}
 	}
+	StatLeave();
 }
 void WriteChar(char ch, int color)
 // writes character to display at current cursor position.
 {
-	PutCh(ch,curX*6, curY*8, color);
+	if (ch == '\n')  // new line
+	{
+		curX = TextCols()-1;
+		AdvanceCursor();
+		return;
+	}
+	if (TextShadowSet(ch,curX,curY,color))  // skip cells already showing ch
+		PutCh(ch,curX*6, TextY(curY), color);
 	AdvanceCursor();
 }
+void TextRun (byte cols[][5], byte count, byte x, byte y, int color)
+// stream count glyphs as one 6*count x 8 window, gap column and
+// bottom row included, in a single RAMWR burst
+{
+	byte hi = color >> 8, lo = color & 0xFF;
+	int c444 = Color444(color);
+	SetAddrWindow(x,y,x+6*count-1,y+7);
+	WriteCmd(RAMWR);
+	if (!pix444)  // Stream444 counts its own bytes
+		StatData(84L*count);  // 7 glyph rows of 6 pixels per char
+	for (byte mask=0x01; mask<0x80; mask<<=1)  // glyph rows, top down
+		for (byte i=0; i<count; i++)
+		{
+			GLYPH_PIXEL(cols[i][0]);
+			GLYPH_PIXEL(cols[i][1]);
+			GLYPH_PIXEL(cols[i][2]);
+			GLYPH_PIXEL(cols[i][3]);
+			GLYPH_PIXEL(cols[i][4]);
+			GLYPH_PIXEL(0);  // gap column
+		}
+	Stream565(BLACK,6*count);  // spacing row under the glyphs
+}
 void WriteString(char *text, int color)
 // writes string to display at current cursor position.
+// note: one window per run of changed chars on a line, not one per char
 {
-	for (;*text;text++)  // for all non-nul chars
-	WriteChar(*text,color);  // write the char
+	StatEnter(STAT_STRING);
+	byte cols[26][5];  // glyphs of one run
+	while (*text)
+	{
+		byte count = 0, start = curX, margin = TextCols();
+		for (; *text && *text!='\n' && curX<margin; text++, curX++)  // up to the right margin
+		{
+			if (!TextShadowSet(*text,curX,curY,color))  // cell already shows it
+			{
+				if (count)
+					TextRun(cols,count,start*6,TextY(curY),color);
+				count = 0;
+				start = curX+1;
+				continue;
+			}
+			FetchGlyph(*text,cols[count++]);
+		}
+		if (count)
+			TextRun(cols,count,start*6,TextY(curY),color);
+		if (*text == '\n')  // new line
+		{
+			text++;
+			curX = margin;
+		}
+		curX--;
+		AdvanceCursor();  // wraps to the next line like WriteChar
+	}
+	StatLeave();
 }
 void WriteInt(int i)
 // writes integer i at current cursor position
@@ -612,6 +2136,409 @@ void WriteHex(int i)
 	itoa(i,str,16);  // convert to base 16 (hex)
 	WriteString(str,WHITE);
 }
+//  ---------------------------------------------------------------------------//  RETAINED SCENE
+#ifdef TFT_SCENE
+SceneNode sceneNodes[SCENE_NODES];
+SceneRect sceneDamage[SCENE_DAMAGE];  // rectangles waiting for SceneUpdate
+byte damageCount;
+int sceneBg;  // background color
+void SceneClear (int bg)
+// forget all nodes; the screen is taken to show bg already
+{
+	memset(sceneNodes,0,sizeof(sceneNodes));
+	damageCount = 0;
+	sceneBg = bg;
+}
+byte SceneBounds (SceneNode *node, SceneRect *r)
+// screen rectangle covered by a visible node; 0 if it covers nothing
+{
+	int x0 = node->x0, y0 = node->y0, x1 = node->x1, y1 = node->y1;
+	if (!node->visible || node->type == SCENE_NONE)
+		return 0;
+	if (node->type == SCENE_FILLCIRCLE)
+	{
+		x0 = node->x0 - node->x1; x1 = node->x0 + node->x1;
+		y0 = node->y0 - node->x1; y1 = node->y0 + node->x1;
+	}
+	else if (node->type == SCENE_LINE)
+	{
+		if (x0 > x1) { x0 = node->x1; x1 = node->x0; }
+		if (y0 > y1) { y0 = node->y1; y1 = node->y0; }
+	}
+	r->x0 = x0 < 0 ? 0 : x0;
+	r->y0 = y0 < 0 ? 0 : y0;
+	r->x1 = x1 > maxX ? maxX : x1;
+	r->y1 = y1 > maxY ? maxY : y1;
+	return 1;
+}
+void SceneDamage (byte x0, byte y0, byte x1, byte y1)
+// mark a rectangle for repainting; touching rectangles are merged,
+// and when the list is full the last one grows to take this one
+{
+	SceneRect r = { x0, y0, x1, y1 };
+	for (byte i=0; i<damageCount; )
+	{
+		SceneRect *d = &sceneDamage[i];
+		if (r.x0 > d->x1+1 || d->x0 > r.x1+1 || r.y0 > d->y1+1 || d->y0 > r.y1+1)
+		{
+			i++;  // apart
+			continue;
+		}
+		if (d->x0 < r.x0) r.x0 = d->x0;  // merge and look again
+		if (d->y0 < r.y0) r.y0 = d->y0;
+		if (d->x1 > r.x1) r.x1 = d->x1;
+		if (d->y1 > r.y1) r.y1 = d->y1;
+		*d = sceneDamage[--damageCount];
+		i = 0;
+	}
+	if (damageCount == SCENE_DAMAGE)  // full: grow the last one
+	{
+		SceneRect *d = &sceneDamage[--damageCount];
+		if (d->x0 < r.x0) r.x0 = d->x0;
+		if (d->y0 < r.y0) r.y0 = d->y0;
+		if (d->x1 > r.x1) r.x1 = d->x1;
+		if (d->y1 > r.y1) r.y1 = d->y1;
+	}
+	sceneDamage[damageCount++] = r;
+}
+void SceneDamageNode (SceneNode *node)
+// mark what node covers for repainting
+{
+	SceneRect r;
+	if (SceneBounds(node,&r))
+		SceneDamage(r.x0,r.y0,r.x1,r.y1);
+}
+void SceneSet (byte id, byte type, byte x0, byte y0, byte x1, byte y1, int color, const char *text)
+// change node id; damages its old and new bounds unless nothing changed
+{
+	SceneNode *node = &sceneNodes[id];
+	if (node->type == type && node->x0 == x0 && node->y0 == y0 && node->x1 == x1 &&
+		node->y1 == y1 && node->color == color && node->text == text && type != SCENE_TEXT)
+		return;
+	SceneDamageNode(node);  // where it was
+	if (node->type == SCENE_NONE)
+		node->visible = 1;  // new nodes start visible
+	node->type = type;
+	node->x0 = x0; node->y0 = y0;
+	node->x1 = x1; node->y1 = y1;
+	node->color = color;
+	node->text = text;
+	SceneDamageNode(node);  // where it is now
+}
+void SceneFillRect (byte id, byte x0, byte y0, byte x1, byte y1, int color)
+// node id is a filled rectangle
+{
+	SceneSet(id,SCENE_RECT,x0,y0,x1,y1,color,0);
+}
+void SceneFillCircle (byte id, byte x, byte y, byte r, int color)
+// node id is a filled circle
+{
+	SceneSet(id,SCENE_FILLCIRCLE,x,y,r,0,color,0);
+}
+void SceneLine (byte id, byte x0, byte y0, byte x1, byte y1, int color)
+// node id is a line
+{
+	SceneSet(id,SCENE_LINE,x0,y0,x1,y1,color,0);
+}
+void SceneText (byte id, byte x, byte y, const char *text, int color)
+// node id is a 5x7 text string; always repainted, the text may have changed
+{
+	int right = x + 6*(int)strlen(text) - 2;  // last glyph column
+	if (right > 255) right = 255;
+	SceneSet(id,SCENE_TEXT,x,y,right,y+6,color,text);
+}
+void SceneShow (byte id, byte visible)
+// show or hide node id
+{
+	SceneNode *node = &sceneNodes[id];
+	if (node->visible == visible)
+		return;
+	SceneDamageNode(node);  // hidden: its old area
+	node->visible = visible;
+	SceneDamageNode(node);  // shown: its new area
+}
+void SceneDraw (SceneNode *node)
+// draw one node, clipped to the current clip rectangle
+{
+	switch (node->type)
+	{
+		case SCENE_RECT:
+			FillRect(node->x0,node->y0,node->x1,node->y1,node->color);
+			break;
+		case SCENE_FILLCIRCLE:
+			FillCircle(node->x0,node->y0,node->x1,node->color);
+			break;
+		case SCENE_LINE:
+			Line(node->x0,node->y0,node->x1,node->y1,node->color);
+			break;
+		case SCENE_TEXT:
+			for (int x=node->x0, i=0; node->text[i] && x<=maxX; x+=6, i++)
+				PutCh(node->text[i],x,node->y0,node->color);
+			break;
+	}
+}
+void SceneUpdate()
+// repaint every damaged rectangle: background, then the nodes on it
+// in id order. Nodes under a rect node that covers the whole damaged
+// rectangle are skipped, and so is the background. Rects and circles
+// are composited; lines and text are drawn over what is queued so far.
+{
+	byte cx0 = clipX0, cy0 = clipY0, cx1 = clipX1, cy1 = clipY1;  // restored on exit
+	StatEnter(STAT_SCENE);
+	for (byte i=0; i<damageCount; i++)
+	{
+		SceneRect *d = &sceneDamage[i], r;
+		byte first = 0, id;
+		SetClip(d->x0,d->y0,d->x1,d->y1);
+		for (id=SCENE_NODES; id>0; id--)  // topmost rect covering it all
+		{
+			SceneNode *node = &sceneNodes[id-1];
+			if (node->type == SCENE_RECT && SceneBounds(node,&r) &&
+				r.x0 <= d->x0 && r.y0 <= d->y0 && r.x1 >= d->x1 && r.y1 >= d->y1)
+				break;
+		}
+		CompositeBegin();
+		if (id)
+			first = id-1;
+		else
+			CompositeFillRect(d->x0,d->y0,d->x1,d->y1,sceneBg);
+		for (id=first; id<SCENE_NODES; id++)
+		{
+			SceneNode *node = &sceneNodes[id];
+			if (!SceneBounds(node,&r) || r.x0 > d->x1 || d->x0 > r.x1 || r.y0 > d->y1 || d->y0 > r.y1)
+				continue;
+			if (node->type == SCENE_RECT)
+				CompositeFillRect(node->x0,node->y0,node->x1,node->y1,node->color);
+			else if (node->type == SCENE_FILLCIRCLE)
+				CompositeFillCircle(node->x0,node->y0,node->x1,node->color);
+			else
+			{
+				CompositeCommit();  // what is under it goes first
+				SceneDraw(node);
+			}
+		}
+		CompositeCommit();
+	}
+	damageCount = 0;
+	SetClip(cx0,cy0,cx1,cy1);
+	StatLeave();
+}
+#endif
+//  ---------------------------------------------------------------------------//  TIME-SLICED JOBS
+#ifdef TFT_JOBS
+Job jobs[JOB_QUEUE];
+byte jobHead, jobTail;  // next free slot, job being drawn
+Job *JobAdd (byte type)
+// next free queue slot, running jobs until there is one
+{
+	while (((jobHead+1) & (JOB_QUEUE-1)) == jobTail)  // queue full
+		JobRun(JOB_BUDGET);
+	Job *job = &jobs[jobHead];
+	job->type = type;
+	job->next = 0;
+	jobHead = (jobHead+1) & (JOB_QUEUE-1);
+	return job;
+}
+void JobFillRect (byte x0, byte y0, byte x1, byte y1, int color)
+// queue a filled rectangle
+{
+	Job *job = JobAdd(JOB_FILL);
+	job->x0 = x0; job->y0 = y0;
+	job->x1 = x1; job->y1 = y1;
+	job->color = color;
+}
+void JobClearScreen()
+// queue a full screen clear
+{
+	JobFillRect(0,0,maxX,maxY,BLACK);
+	TextShadowFill(' ');
+}
+void JobFillCircle (byte xPos, byte yPos, byte radius, int color)
+// queue a filled circle, same pixels as FillCircle
+{
+	Job *job = JobAdd(JOB_CIRCLE);
+	job->x0 = xPos; job->y0 = yPos;
+	job->x1 = radius;
+	job->color = color;
+}
+void JobString (byte x, byte y, const char *text, int color)
+// queue a text line of 6x8 cells at x,y, cut at the right edge
+{
+	Job *job = JobAdd(JOB_TEXT);
+	job->x0 = x; job->y0 = y;
+	job->text = text;
+	job->color = color;
+}
+byte JobStep (Job *job, unsigned int *spent, unsigned int budget)
+// send units of one job while the budget allows, and at least one if
+// nothing was sent yet in this JobRun; nonzero when the job is done
+{
+	if (job->type == JOB_FILL)  // clipped like FillRect, a slice at a time
+	{
+		byte x0 = job->x0 > clipX0 ? job->x0 : clipX0;
+		byte x1 = job->x1 < clipX1 ? job->x1 : clipX1;
+		int top = job->y0 + job->next;
+		int bottom = job->y1 < clipY1 ? job->y1 : clipY1;
+		if (top < clipY0)  // rows above the clip rectangle are done
+		{
+			top = clipY0;
+			job->next = top - job->y0;
+		}
+		if (x0 > x1 || top > bottom)  // the rest is outside it
+			return 1;
+		int width = x1 - x0 + 1;
+		int left = bottom - top + 1;  // rows to go
+		int rows = (budget > *spent+11) ? (budget - *spent - 11) / (2*width) : 0;
+		if (rows == 0 && *spent == 0) rows = 1;  // always progress
+		if (rows > left) rows = left;
+		if (rows > 0)
+		{
+			SetAddrWindow(x0,top,x1,top+rows-1);
+			Write565(job->color,(long)width*rows);
+			*spent += 11 + 2*width*rows;
+			job->next += rows;
+		}
+		return rows == left;
+	}
+	if (job->type == JOB_CIRCLE)
+	{
+		int r = job->x1;
+		while (job->next <= 2*r)
+		{
+			int dy = job->next - r;
+			int half = RoundHalf(r,abs(dy));
+			unsigned int cost = 11 + 2*(2*half+1) + r;  // r: RoundHalf's walk
+			if (*spent && *spent + cost > budget)
+				return 0;
+			HSpan(job->x0-half,job->x0+half,job->y0+dy,job->color);
+			*spent += cost;
+			job->next++;
+		}
+		return 1;
+	}
+	// JOB_TEXT: runs of 6x8 cells
+	byte cols[26][5], count = 0;
+	int x = job->x0 + 6*job->next;
+	while (job->text[job->next+count] && x+6*count+5 <= maxX && count < 26)
+	{
+		if (*spent + 11 + 96*(count+1) > budget && (count || *spent))
+			break;  // out of budget
+		FetchGlyph(job->text[job->next+count],cols[count]);
+		count++;
+	}
+	if (count)
+	{
+		TextRun(cols,count,x,job->y0,job->color);
+		*spent += 11 + 96*count;
+		job->next += count;
+	}
+	return !job->text[job->next] || x+6*count+5 > maxX;
+}
+byte JobRun (unsigned int budget)
+// send about budget bytes of queued drawing; nonzero while jobs remain
+{
+	unsigned int spent = 0;
+	if (jobTail == jobHead)
+		return 0;
+	StatEnter(STAT_JOB);
+	while (jobTail != jobHead && (spent == 0 || spent < budget))
+	{
+		if (!JobStep(&jobs[jobTail],&spent,budget))
+			break;  // budget used up inside the job
+		jobTail = (jobTail+1) & (JOB_QUEUE-1);
+	}
+	StatLeave();
+	return jobTail != jobHead;
+}
+byte JobBusy()
+// nonzero while jobs remain
+{
+	return jobTail != jobHead;
+}
+#endif
+//  ---------------------------------------------------------------------------//  STRIP CHART
+void StripBegin (StripChart *sc, byte x0, byte y0, byte x1, byte y1, int color, int bg)
+// clear the plot area and start the sweep at its left edge
+{
+	if (x1-x0 >= STRIP_MAX)
+		x1 = x0+STRIP_MAX-1;
+	sc->x0 = x0; sc->y0 = y0;
+	sc->x1 = x1; sc->y1 = y1;
+	sc->color = color;
+	sc->bg = bg;
+	sc->cursor = 0;
+	memset(sc->sample,STRIP_NONE,sizeof(sc->sample));  // no trace in any column
+	FillRect(x0,y0,x1,y1,bg);
+}
+void StripSpan (StripChart *sc, byte col, byte left, byte *lo, byte *hi)
+// rows the sample of column col covers: from it to left, the sample to
+// its left when it was drawn (none in column 0); lo > hi if no sample
+{
+	*lo = 1; *hi = 0;
+	if (sc->sample[col] == STRIP_NONE)
+		return;
+	*lo = *hi = sc->sample[col];
+	if (col && left != STRIP_NONE)
+	{
+		if (left < *lo) *lo = left;
+		if (left > *hi) *hi = left;
+	}
+}
+void StripColumn (StripChart *sc, byte col, byte oldLo, byte oldHi, byte lo, byte hi)
+// show rows lo..hi of column col in the trace color (none if lo > hi),
+// blanking the rest of oldLo..oldHi it showed; one window over the
+// changed rows
+{
+	byte top = lo, bottom = hi;  // rows to send
+	if (oldLo <= oldHi)  // old trace to erase
+	{
+		if (lo > hi)
+		{
+			top = oldLo;
+			bottom = oldHi;
+		}
+		else
+		{
+			if (oldLo < top) top = oldLo;
+			if (oldHi > bottom) bottom = oldHi;
+		}
+	}
+	if (top > bottom)  // nothing shown before or now
+		return;
+	SetAddrWindow(sc->x0+col,top,sc->x0+col,bottom);
+	WriteCmd(RAMWR);
+	if (lo > hi)  // erase only
+		Stream565(sc->bg,bottom-top+1);
+	else
+	{
+		Stream565(sc->bg,lo-top);  // old trace above
+		Stream565(sc->color,hi-lo+1);  // new span
+		Stream565(sc->bg,bottom-hi);  // old trace below
+	}
+}
+void StripAdd (StripChart *sc, byte value)
+// plot value (0 = bottom row) at the cursor, joined to the previous
+// sample by a vertical span, then blank the column ahead
+{
+	StatEnter(STAT_STRIP);
+	byte width = sc->x1 - sc->x0 + 1, col = sc->cursor;
+	byte next = col+1 < width ? col+1 : 0;
+	byte left = col ? sc->sample[col-1] : STRIP_NONE;
+	byte was = sc->sample[col];  // shown only if there is no blank column
+	byte oldLo = 1, oldHi = 0, lo, hi;
+	if (width == 1)
+		StripSpan(sc,col,left,&oldLo,&oldHi);
+	sc->sample[col] = value > sc->y1 - sc->y0 ? sc->y0 : sc->y1 - value;  // clipped to the plot
+	StripSpan(sc,col,left,&lo,&hi);
+	StripColumn(sc,col,oldLo,oldHi,lo,hi);
+	if (width > 1)  // sweep gap ahead of the cursor
+	{
+		StripSpan(sc,next,was,&oldLo,&oldHi);  // drawn next to the sample just replaced
+		StripColumn(sc,next,oldLo,oldHi,1,0);
+	}
+	sc->cursor = next;
+	StatLeave();
+}
 //  ---------------------------------------------------------------------------//  TEST ROUTINES
 void PixelTest()
 // draws 4000 pixels on the screen
@@ -658,8 +2585,15 @@ void PortraitChars()
 void InitTFT() {
 	//  
 	SetupPorts();  // use PortB for LCD interface
-	HardwareReset();
 	OpenSPI();  // start communication to TFT
-	InitDisplay();  // initialize TFT controller 
-	ClearScreen();
+	InitDisplayNoOn();  // reset and wake the TFT controller
+	ClearScreen();  // before DISPON, so the power-on garbage is never shown
+	DisplayOn();
+}
+void InitTFTNoClear()
+// for a first frame that covers every pixel: draw it, then call DisplayOn
+{
+	SetupPorts();
+	OpenSPI();
+	InitDisplayNoOn();
 }
\ No newline at end of file
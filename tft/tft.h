@@ -23,6 +23,10 @@
 // TFT pin MISO: n/c
 // TFT pin +5V: +5V
 //
+// With TFT_USART_SPI (ATmega328, USART0 in Master SPI mode):
+// TFT pin MOSI: PD1(TXD)
+// TFT pin SCK: PD4(XCK)
+//
 //  ---------------------------------------------------------------------------//  GLOBAL DEFINES
 #pragma once
 #define ClearBit(x,y) x &= ~_BV(y)  // equivalent to cbi(x,y)
@@ -30,13 +34,18 @@
 //  ---------------------------------------------------------------------------//  ST7735 ROUTINES
 #define SWRESET 0x01  // software reset
 #define SLPOUT  0x11  // sleep out
+#define NORON  0x13  // normal display mode, ends scrolling
 #define DISPOFF 0x28  // display off
 #define DISPON  0x29  // display on
 #define CASET  0x2A  // column address set
 #define RASET  0x2B  // row address set
 #define RAMWR  0x2C  // RAM write 
+#define VSCRDEF 0x33  // vertical scroll area: top fixed, scroll, bottom fixed lines
 #define MADCTL  0x36    // axis control
+#define VSCSAD  0x37  // vertical scroll start address
 #define COLMOD  0x3A  // color mode
+#define INIT_DELAY 0xFF  // init table pseudo command: wait the next byte in mS
+#define INIT_END 0x00  // ends an init table (in place of NOP)
 // ------------------------------------------------------------------------//    1.8" TFT display constants
 #define XSIZE  128
 #define YSIZE  160
@@ -52,17 +61,135 @@
 #define MAGENTA 0xF81F
 #define YELLOW  0xFFE0
 #define WHITE  0xFFFF
+#define Color444(c) ((((c) >> 4) & 0xF00) | (((c) >> 3) & 0x0F0) | (((c) >> 1) & 0x00F))  // RGB565 to RGB444: top 4 bits of each channel
+#define Color565(c) ((((c) & 0xF00) << 4) | ((c) & 0x800) | (((c) & 0x0F0) << 3) | (((c) & 0x0C0) >> 1) | (((c) & 0x00F) << 1) | (((c) & 0x008) >> 3))  // RGB444 to RGB565, low bits copied from the top
 //  ---------------------------------------------------------------------------//  INCLUDES
+#ifdef TFT_HOST
+#include "tft_host.h"  // ST7735 emulator stands in for the AVR headers
+#else
 #include <avr/io.h>  // deal with port registers
 #include <avr/interrupt.h>  // deal with interrupt calls
 #include <avr/pgmspace.h>  // put character data into progmem
 #include <util/delay.h>  // used for _delay_ms function
-#include <string.h>  // string manipulation routines
 #include <avr/sleep.h>  // used for sleep functions
+#endif
+#include <string.h>  // string manipulation routines
 #include <stdlib.h>
+//  ---------------------------------------------------------------------------//  TRANSPORT
+//
+// Every byte to the controller goes through these macros, so the same
+// driver code runs on the board or against the host emulator (tft_host.c).
+// SpiOut starts a byte, SpiWait waits until it may be followed by the next,
+// SpiDrain waits until the last byte has left the wire (before D/C changes).
+// SpiIrqOut is SpiOut from the pump interrupt.
+//
+// Build with -DTFT_USART_SPI to send through USART0 in Master SPI mode
+// instead of the SPI port. Its transmit register is double buffered, so
+// the next byte is loaded while the current one shifts and pixel data
+// streams without the poll-and-reload gap of the SPI port.
+// SpiStream, where defined, is the byte write used by the Stream565 fill
+// kernel; without it (SPI port) the kernel is cycle-counted assembly,
+// timed for SCK osc/2. At any slower SPI divider the fills poll SPIF
+// byte by byte instead (SpiByteCycles tells them), as the timed writes
+// would collide with the byte still shifting out.
+#ifdef TFT_HOST
+#define SpiOut(b) HostSpiOut(b)  // emulator decodes the byte at once
+#define SpiStream(b) HostSpiStream(b)  // charged like the assembly kernel
+#define SpiIrqOut(b) HostSpiIrq(b)  // charged the interrupt time
+#define CpuCycles(n) HostCpuCycles(n)  // estimated CPU work between bus bytes
+#define SpiWait() do {} while (0)  // nothing to wait for
+#define SpiDrain() do {} while (0)
+#define SpiIn() 0  // MISO is not connected
+#define SpiIrqOn() SetBit(SPCR,SPIE)  // no interrupts on the host (see PumpWait)
+#define SpiIrqOff() ClearBit(SPCR,SPIE)
+#define DcCommand() HostSetDC(0)  // D/C low: command byte follows
+#define DcData() HostSetDC(1)  // D/C high: data bytes follow
+#define ResetLow() HostSetReset(0)  // pull TFT reset low
+#define ResetHigh() HostSetReset(1)  // release TFT reset
+#elif defined(TFT_USART_SPI)
+#define SpiOut(b) do { while (!(UCSR0A & _BV(UDRE0))); UCSR0A = _BV(TXC0); UDR0 = (b); } while (0)
+#define SpiWait() do {} while (0)  // double buffered: load the next byte right away
+#define SpiStream(b) SpiOut(b)  // the buffer already keeps the wire busy
+#define SpiDrain() while (!(UCSR0A & _BV(TXC0)))  // shift register empty
+#define SpiIn() 0  // receiver is off: MISO is not connected
+#define SpiIrqOn() SetBit(UCSR0B,UDRIE0)  // data register empty interrupt
+#define SpiIrqOff() ClearBit(UCSR0B,UDRIE0)
+#define SPI_PUMP_vect USART_UDRE_vect
+#else
+#define SpiOut(b) SPDR = (b)
+#define SpiWait() while (!(SPSR & 0x80))
+#define SpiDrain() do {} while (0)  // SpiWait already waited for the whole byte
+#define SpiIn() SPDR
+#define SpiIrqOn() SetBit(SPCR,SPIE)  // transfer complete interrupt
+#define SpiIrqOff() ClearBit(SPCR,SPIE)
+#define SPI_PUMP_vect SPI_STC_vect
+#endif
+#ifndef TFT_HOST
+#define SpiIrqOut(b) SpiOut(b)
+#define CpuCycles(n) do {} while (0)  // only the emulator needs telling
+#define DcCommand() ClearBit(PORTB,4)  // B4=DC; 0=command, 1=data
+#define DcData() SetBit(PORTB,4)
+#define ResetLow() ClearBit(PORTB,6)  // B6=RESET, active low
+#define ResetHigh() SetBit(PORTB,6)
+#endif
 //  ---------------------------------------------------------------------------//  TYPEDEFS
 typedef uint8_t byte;  // I just like byte & sbyte better
 typedef int8_t sbyte;
+//  ---------------------------------------------------------------------------//  SPI TRAFFIC ACCOUNTING
+//
+// Build with -DTFT_STATS to count the bus traffic of every public primitive.
+// Nested calls (Line -> DrawPixel) are charged to the outermost primitive;
+// traffic outside any primitive (init, orientation) goes to STAT_OTHER.
+// Without TFT_STATS the hooks compile to nothing.
+#define STAT_OTHER  0
+#define STAT_CLEAR  1
+#define STAT_PIXEL  2
+#define STAT_HLINE  3
+#define STAT_VLINE  4
+#define STAT_LINE  5
+#define STAT_RECT  6
+#define STAT_FILLRECT 7
+#define STAT_CIRCLE  8
+#define STAT_ROUNDRECT 9
+#define STAT_FILLCIRCLE 10
+#define STAT_ELLIPSE 11
+#define STAT_FILLELLIPSE 12
+#define STAT_PUTCH  13
+#define STAT_FILLROUNDRECT 14
+#define STAT_STRING  15
+#define STAT_STRIP  16
+#define STAT_SCENE  17
+#define STAT_COMPOSITE 18
+#define STAT_BAND  19
+#define STAT_MONO  20
+#define STAT_JOB  21
+#define STAT_STREAM  22
+#define STAT_PIXELS  23
+#define STAT_COUNT  24
+#ifdef TFT_STATS
+typedef struct
+{
+	unsigned long calls;  // outermost calls of the primitive
+	unsigned long commands;  // command bytes
+	unsigned long params;  // command parameter bytes
+	unsigned long pixels;  // pixel data bytes
+	unsigned long windows;  // address window changes
+} TftStat;
+extern TftStat tftStats[STAT_COUNT];
+void StatEnter(byte prim); // charge traffic to prim until the matching StatLeave
+void StatLeave(); // end of a primitive
+void StatCmd(byte cmd); // count a command byte
+void StatData(unsigned long n); // count n data bytes (pixels if after RAMWR)
+void StatWindow(); // count an address window change
+void StatsClear(); // zero all counters
+void StatsReport(void (*emit)(char *line)); // CSV report, one line per primitive
+#else
+#define StatEnter(prim) do {} while (0)
+#define StatLeave() do {} while (0)
+#define StatCmd(cmd) do {} while (0)
+#define StatData(n) do {} while (0)
+#define StatWindow() do {} while (0)
+#endif
 //  ---------------------------------------------------------------------------//  MISC ROUTINES
 void SetupPorts(); //init ports
 void msDelay(int delay); // to remove code inlining
@@ -81,25 +208,142 @@ unsigned long intsqrt(unsigned long val);// calculate integer value of square ro
 // CPHA - 0=read on rising-edge, 1=read on falling-edge
 // SPRx - 00=osc/4, 01=osc/16, 10=osc/64, 11=osc/128
 // SPCR = 0x50: SPI enabled as Master, mode 0, at 16/4 = 4 MHz
-void OpenSPI(); //SPI enabled as Master, Mode0 at 4 MHz //start of spi transfer
+void OpenSPI(); //SPI (or USART MSPIM) enabled as Master, Mode0 at osc/2 //start of spi transfer
 void CloseSPI(); //Clear SPI enable bit //finish of spi transfer
+byte Xfer(byte data); //send one byte and wait for it to finish
+void SetSpiDivider (byte divider); // SCK = osc/divider (2..128, a power of two); OpenSPI sets 2
+unsigned int SpiByteCycles(); // CPU cycles per byte at the configured SCK: 16 at osc/2
 void WriteCmd (byte cmd); //write command to tft
 void WriteByte (byte b); //write 8 bit data to tft
 void WriteWord (int w); //write 16 bit data to tft
 void Write888 (long data, int count); //write 24 bit to tft
-void Write565 (int data, unsigned int count);// send 16-bit pixel data to the controller // note: inlined spi xfer for optimization
-void HardwareReset(); //reset tft
-void InitDisplay(); //init tft
-void SetAddrWindow(byte x0, byte y0, byte x1, byte y1); //rectangular area
+void Stream565 (int data, unsigned long count); // fill kernel: count pixels of one color, after RAMWR
+void StreamPixels (int *pixels, unsigned int count); // send count RGB565 pixels from RAM, after RAMWR
+//
+// SetColorMode(12) switches the controller to RGB444 (COLMOD 3): two pixels
+// in three bytes. Every pixel path keeps taking RGB565 colors and packs
+// them; a pixel left over at the end of a window is sent paired with the
+// window's first pixel, which the write pointer wraps back onto, so odd
+// windows cost one extra pixel (a lone DrawPixel is 3 bytes, not 2).
+// A stream that stops short on an odd pixel (EndWindow, or any command)
+// sends it through a one-pixel window of its own: 14 more bytes.
+extern byte pix444;  // nonzero in 12-bit mode
+void SetColorMode (byte bits); // 16 = RGB565, 12 = RGB444
+void Stream444 (int data, unsigned long count); // 12-bit fill kernel: count pixels of one RGB444 color, after RAMWR
+void Write444 (int data, unsigned long count); // send count pixels of one RGB444 color in 12-bit mode
+void Pad444(); // complete a half-sent pixel pair, before the next command
+void Write565 (int data, unsigned long count);// send 16-bit pixel data to the controller // note: inlined spi xfer for optimization
+void HardwareReset(); //reset tft, and the driver's orientation, clip, window cache and pixel mode with it
+void SendCommands(const byte *table); //run a PROGMEM table of command, parameter count, parameters
+void InitDisplay(); //reset and wake the controller, display on
+void InitDisplayNoOn(); //the same with the display left off, for a first frame drawn before DisplayOn
+void DisplayOn(); //show GRAM, after InitDisplayNoOn
+void InvalidateAddrWindow(); //forget the cached window: next SetAddrWindow sends both axes
+void SetAddrWindow(byte x0, byte y0, byte x1, byte y1); //rectangular area, sends only the axes that changed
 void ClearScreen(); //clear tft
+//  ---------------------------------------------------------------------------//  SPI PIXEL PUMP
+//
+// FillRectAsync and ClearScreenAsync fill like FillRect (unclipped) and
+// ClearScreen. At the default SCK (osc/2) they block like them: nothing
+// faster than the polled kernel can keep up with 16 cycles a byte, and
+// an interrupt per byte costs more than that.
+//
+// Built with -DTFT_PUMP and run at osc/8 or slower (SetSpiDivider(8)),
+// they queue the run (window, color, count) and return at once; the SPI
+// transfer-complete interrupt (USART data register empty with
+// TFT_USART_SPI) then sends the CASET, RASET, RAMWR and pixel bytes
+// while the program carries on. Global interrupts must be enabled. Any
+// blocking routine waits for the queue to drain before it touches the
+// bus (WriteCmd calls PumpWait). Every byte costs one interrupt, about
+// PUMP_ISR_CYCLES with entry and exit, so at osc/8 (64 cycles a byte)
+// 24 of every 64 cycles are left to the program, and fills take 4 times
+// as long on the wire as at osc/2; the other drawing routines poll at
+// that clock (see SpiByteCycles). This suits a program with work to do
+// between occasional large fills, not one that draws most of the time.
+// On the host the queue drains in PumpWait, and the emulator charges
+// every pump byte the interrupt time.
+#ifdef TFT_PUMP
+#define PUMP_QUEUE 4  // queued runs, must be a power of two
+#define PUMP_ISR_CYCLES 40  // one pump interrupt, entry and exit included
+#define PUMP_MIN_CYCLES 64  // shortest byte time at which the pump is used
+typedef struct
+{
+	byte x0, y0, x1, y1;  // address window
+	int color;  // RGB565 fill color
+	unsigned int count;  // pixels to send
+} PumpRun;
+void PumpNext(); // send the next queued byte (SPI interrupt handler body)
+byte PumpBusy(); // nonzero while queued runs are still being sent
+void PumpWait(); // wait until every queued run has been sent
+#else
+#define PumpBusy() 0
+#define PumpWait() do {} while (0)
+#endif
+void FillRectAsync (byte x0, byte y0, byte x1, byte y1, int color); // fill a rectangle, queued to the pump if SCK is slow enough
+void ClearScreenAsync(); // clear the screen, queued to the pump if SCK is slow enough
+//  ---------------------------------------------------------------------------//  1BPP FRAMEBUFFER
+//
+// Build with -DTFT_MONO_FB for two-color panels on parts with RAM to
+// spare (ATmega1284): between MonoBegin and MonoEnd every primitive
+// draws into a 1 bit per pixel framebuffer instead of the panel. The
+// window, RAMWR and pixel stream are caught in SetAddrWindow, WriteCmd
+// and the stream routines, so all of tft.c works unchanged; the
+// background color gives 0 bits, any other color 1 bits.
+// MonoFlush compares the touched rows with a copy of what the panel
+// shows and sends only the changed byte columns of the changed rows,
+// expanded to fg/bg RGB565, one window per run of rows. A frame can be
+// cleared and redrawn in full every time without flicker, and only
+// what really changed goes over the bus. RAM: two bitmaps of 2560
+// bytes and 20 bytes of row flags. Console scrolling and the async
+// fills (drawn at once) are not buffered.
+#ifdef TFT_MONO_FB
+#define MONO_BYTES (XSIZE*YSIZE/8)
+extern byte monoActive;  // nonzero between MonoBegin and MonoEnd
+extern byte monoFb[MONO_BYTES], monoShown[MONO_BYTES];  // drawn and displayed bitmaps, MSB = leftmost pixel
+void MonoBegin (int fg, int bg); // draw into the framebuffer from now on; the panel is taken to show bg
+void MonoFlush(); // send what changed since the last flush
+void MonoEnd(); // flush and draw to the panel directly again
+void MonoWindow (byte x0, byte y0, byte x1, byte y1); // SetAddrWindow in framebuffer mode
+void MonoRamwr(); // RAMWR in framebuffer mode: restart the write pointer
+void MonoPixels (int color, unsigned long count); // count pixels of color at the framebuffer write pointer
+void MonoSpan (int y, int a, int b, byte on); // set or clear pixels a..b of row y
+byte MonoChanged (int y, byte *lo, byte *hi); // byte columns lo..hi of row y that differ from the panel; 0 if none
+#endif
 //  ---------------------------------------------------------------------------//  SIMPLE GRAPHICS ROUTINES
 //
 // note: many routines have byte parameters, to save space,
 // but these can easily be changed to int params for larger displays.
+//
+// DrawPixel, FillRect, the spans (so Line, circles, ellipses and rounded
+// shapes) and PutCh draw only inside the clip rectangle, which is the
+// whole screen unless SetClip narrows it. HLine, VLine, the text runs and
+// the async fills are not clipped.
+extern byte clipX0, clipY0, clipX1, clipY1;
+void SetClip (byte x0, byte y0, byte x1, byte y1); // limit drawing to x0..x1, y0..y1
+void ClearClip(); // drawing allowed on the whole screen again
 void DrawPixel (byte x, byte y, int color); //draw the pixel
+typedef struct
+{
+	byte x, y;
+} Point;
+//
+// DrawPixels and DrawPixelsColumns send about half the bytes DrawPixel
+// would. The points are binned in place by blocks of POINT_BLOCK rows
+// (columns) and each block is marked in a bitmap, so the order they
+// come in does not matter: two passes over the points and one over the
+// bitmap, about 250 bytes of stack.
+#define POINT_BLOCK 8  // rows binned together
+#define POINT_BINS (YSIZE/POINT_BLOCK)  // bins on the longer side; one more for points off the screen
+#define BIN_POINT_CYCLES 60  // count, move and mark one point on the AVR
+#define BIN_BYTE_CYCLES 6  // look at 8 points of a bitmap row
+#define BIN_BIT_CYCLES 6  // look at one point of a busy bitmap byte
+void DrawPixels (Point *points, unsigned int n, int color); // draw n points, binned in place by row, neighbours on a row sent as one run
+void DrawPixelsColumns (Point *points, unsigned int n, int color); // the same binned by column, neighbours in a column sent as one run
 void HLine (byte x0, byte x1, byte y, int color); // draws a horizontal line in given color
 void VLine (byte x, byte y0, byte y1, int color);// draws a vertical line in given color
-void Line (int x0, int y0, int x1, int y1, int color); // an elegant implementation of the Bresenham algorithm 
+void HSpan (int x0, int x1, int y, int color); // draws a horizontal run from x0 to x1 (either order), clipped
+void VSpan (int x, int y0, int y1, int color); // draws a vertical run from y0 to y1 (either order), clipped
+void Line (int x0, int y0, int x1, int y1, int color); // Bresenham line, sent as one address window per horizontal/vertical run
 void DrawRect (byte x0, byte y0, byte x1, byte y1, int color); // draws a rectangle in given color
 void FillRect (byte x0, byte y0, byte x1, byte y1, int color); //filled rectangular
 void CircleQuadrant (byte xPos, byte yPos, byte radius, byte quad, int color);// draws circle quadrant(s) centered at x,y with given radius & color
@@ -109,13 +353,100 @@ void CircleQuadrant (byte xPos, byte yPos, byte radius, byte quad, int color);//
 // bit 1: draw quadrant IV (upper right)
 // bit 2: draw quadrant II (lower left)
 // bit 3: draw quadrant III (upper left)
+void OctantRuns (int xl, int yt, int xr, int yb, int h, int a, int b, byte octants, int color); // sends one run of the circle walk in every selected octant
+void RoundOutline (int xl, int yt, int xr, int yb, byte radius, byte octants, int color); // midpoint circle walk; left/right centres xl,xr, top/bottom centres yt,yb
+void Arc (byte xPos, byte yPos, byte radius, byte octants, int color); // draws the 45-degree arcs selected by octants
+// bit n covers n*45 to (n+1)*45 degrees, counterclockwise from 3 o'clock
 void Circle (byte xPos, byte yPos, byte radius, int color); // draws circle at x,y with given radius & color
 void RoundRect (byte x0, byte y0, byte x1, byte y1, byte r, int color); // draws a rounded rectangle with corner radius r. // coordinates: top left = x0,y0; bottom right = x1,y1 
+void FillRows (int xl, int yt, int xr, int yb, int dy, int half, int color); // fills the rows dy above yt and dy below yb, from xl-half to xr+half
+void RoundFill (int xl, int yt, int xr, int yb, byte radius, int color); // scanline fill of a circle split at xl..xr and yt..yb
 void FillCircle (byte xPos, byte yPos, byte radius, int color); // draws filled circle at x,y with given radius & color
+void FillRoundRect (byte x0, byte y0, byte x1, byte y1, byte r, int color); // draws a filled rounded rectangle with corner radius r
 void Ellipse (int x0, int y0, int width, int height, int color); // draws an ellipse of given width & height
 // two-part Bresenham method
 // note: slight discontinuity between parts on some (narrow) ellipses.
 void FillEllipse(int xPos,int yPos,int width,int height, int color); // draws a filled ellipse of given width & height
+//  ---------------------------------------------------------------------------//  PIXEL STREAMS
+//
+// BeginWindow sends the address window and RAMWR once; PushPixels and
+// PushColor then fill it row by row, left to right, at the speed of
+// StreamPixels and Stream565. The window may extend past the clip
+// rectangle: pixels falling outside it are skipped, not sent. EndWindow
+// closes the stream; no other drawing may come between the two.
+// StreamWindow does all three for a window whose colors come from a
+// callback, STREAM_CHUNK pixels of a row at a time.
+#define STREAM_CHUNK 16  // pixels per StreamWindow callback, on the stack
+typedef void (*PixelSource)(byte x, byte y, byte n, int *pixels); // colors of pixels x..x+n-1 of row y
+void BeginWindow (byte x0, byte y0, byte x1, byte y1); // open x0,y0..x1,y1 for streaming, from its top left pixel
+void PushRun (int *pixels, int color, unsigned long count); // stream count pixels from pixels, or of one color if pixels is 0, clipped
+void PushPixels (int *pixels, unsigned int count); // stream count RGB565 pixels from RAM
+void PushColor (int color, unsigned long count); // stream count pixels of one color
+void EndWindow(); // close the stream
+void StreamWindow (byte x0, byte y0, byte x1, byte y1, PixelSource source); // fill a window with the colors source returns
+//  ---------------------------------------------------------------------------//  COMPOSITOR
+//
+// Between CompositeBegin and CompositeCommit the Composite* calls only
+// queue opaque shapes. CompositeCommit resolves every scanline into runs
+// of final color, later shapes on top, so each pixel goes out once:
+// a pupil on an eye is not sent twice. Rows whose runs have the same
+// extents form a band, and every contiguous stretch of a band is sent
+// as one address window. Shapes are clipped to the clip rectangle.
+// A full queue commits itself.
+//
+// Rows are not stored: CompositeCommit resolves each row once to find
+// the bands and once more for every stretch it sends, and a circle's
+// span costs RoundHalf's walk, O(radius), each time. A commit therefore
+// takes O(rows * stretches * (shapes + sum of radii)); few large circles
+// over one band are cheap, many circles split into stretches are not.
+//
+// Build with -DTFT_COMPOSITE for it; TFT_SCENE and TFT_BAND_HEIGHT,
+// which draw through it, turn it on. The queue takes 7 bytes per shape.
+#define ROUND_STEP_CYCLES 20  // one step of RoundHalf's walk on the AVR, about a byte time at osc/2
+int RoundHalf (byte radius, byte dy); // half-width of the RoundFill row dy from the centre
+#if !defined(TFT_COMPOSITE) && (defined(TFT_SCENE) || defined(TFT_BAND_HEIGHT))
+#define TFT_COMPOSITE
+#endif
+#ifdef TFT_COMPOSITE
+#ifndef COMPOSITE_ITEMS
+#define COMPOSITE_ITEMS 8  // queued shapes
+#endif
+#define COMPOSITE_RUNS (2*COMPOSITE_ITEMS+1)  // most runs one row can split into
+typedef struct
+{
+	byte circle;  // 0: rectangle x0,y0..x1,y1; 1: circle centre x0,y0, radius x1
+	byte x0, y0, x1, y1;
+	int color;
+} CompositeItem;
+typedef struct
+{
+	byte x0, x1;
+	int color;
+} CompositeRun;
+void CompositeBegin(); // start queueing shapes
+void CompositeFillRect (byte x0, byte y0, byte x1, byte y1, int color); // queue a filled rectangle
+void CompositeFillCircle (byte xPos, byte yPos, byte radius, int color); // queue a filled circle
+void CompositeHLine (byte x0, byte x1, byte y, int color); // queue a horizontal line
+void CompositeCommit(); // send the queued shapes, every pixel once
+byte CompositeSpan (CompositeItem *item, int y, int *a, int *b); // clipped span a..b of a queued shape on row y; 0 if none
+byte CompositeRow (int y, CompositeRun *runs); // final-color runs of row y, left to right; returns their count
+byte SameExtents (CompositeRun *a, byte na, CompositeRun *b, byte nb); // nonzero if both rows cover the same pixels
+void CompositeAdd (CompositeItem *item); // queue a shape, committing a full queue first
+#endif
+//
+// Build with -DTFT_BAND_HEIGHT=n for the band renderer: BandCommit draws
+// the compositor's queue over a background into a strip buffer of
+// XSIZE*n pixels (2*128*n bytes of RAM), band by band, and sends the
+// whole area in one window and one RAMWR. Every pixel goes out once,
+// background included, so nothing flickers while the area is redrawn.
+// In landscape a band holds fewer rows, as the buffer size is fixed.
+// A full queue is committed by the compositor before the background is
+// drawn, so a band list must fit in COMPOSITE_ITEMS (-D to raise it).
+#ifdef TFT_BAND_HEIGHT
+#define BAND_PIXELS (XSIZE*TFT_BAND_HEIGHT)
+extern int bandBuf[BAND_PIXELS];
+void BandCommit (byte x0, byte y0, byte x1, byte y1, int bg); // render the queued shapes over bg into x0,y0..x1,y1 in one RAMWR
+#endif
 //  ---------------------------------------------------------------------------//  TEXT ROUTINES
 // 
 // Each ASCII character is 5x7, with one pixel space between characters
@@ -130,15 +461,177 @@ void FillEllipse(int xPos,int yPos,int width,int height, int color); // draws a
 // Display width is 160, so there are 26 chars/row (26x6 = 156).
 // Display height is 128, so there are 16 rows (16x8 = 128).
 // Total number of characters in landscape mode = 26x16 = 416. 
+//
+// Build with -DTFT_TEXT_SHADOW to keep the character and color of every
+// cell (1260 bytes of RAM, so ATmega328 only). WriteChar and WriteString
+// then compare against the shadow and send only the cells that changed,
+// and a status screen can be rewritten in full every refresh.
+// ClearScreen resets the shadow to spaces; after drawing graphics over
+// text call TextShadowFill(0) to force the next write to resend.
+#define TEXT_CELLS 420  // 21x20 portrait, 26x16 landscape
+#ifdef TFT_TEXT_SHADOW
+typedef struct
+{
+	char ch;
+	int color;  // 0 for spaces: they look the same in any color
+} TextCell;
+extern TextCell textShadow[TEXT_CELLS];
+byte TextShadowSet(char ch, byte x, byte y, int color); // record ch at cell x,y; nonzero if the cell changed
+void TextShadowFill(char ch); // set every cell to ch: ' ' after a clear, 0 for unknown
+void TextShadowScroll(byte first); // move cell rows below first up one row, blank the last
+#else
+#define TextShadowSet(ch,x,y,color) 1
+#define TextShadowFill(ch) do {} while (0)
+#define TextShadowScroll(first) do {} while (0)
+#endif
+//
+// Console mode (portrait only): ConsoleBegin makes the rows below the
+// fixed header a hardware-scrolled area (VSCRDEF/VSCSAD). When the
+// cursor passes the last row the area scrolls up one text row, which
+// costs a VSCSAD command and blanking one 8-line strip instead of a
+// redraw. WriteChar and WriteString also move to a new line on '\n'.
+extern byte conFixed, conRows, conOfs;
+void ConsoleBegin(byte fixedRows); // scroll the text rows below fixedRows; cursor to the first of them
+void ConsoleEnd(); // back to normal mode, screen cleared
+void ConsoleScroll(); // scroll the console up one text row, blanking the new last row
+byte TextY(byte row); // display y of text row, following the console scroll
+byte TextCols(); // characters per row in the current orientation
+byte TextRows(); // character rows in the current orientation
 void GotoXY (byte x,byte y); // position cursor on character x,y grid, where 0<x<20, 0<y<19.
 void GotoLine(byte y); // position character cursor to start of line y, where 0<y<19.
-void AdvanceCursor(); // moves character cursor to next position, assuming portrait orientation
+void AdvanceCursor(); // moves character cursor to next position, wrapping at the current orientation's margins
 void SetOrientation(int degrees); // Set the display orientation to 0,90,180,or 270 degrees
+void FetchGlyph (char ch, byte *cols); // copy the 5 column bytes of ch from the font table (bit 0 = top row)
 void PutCh (char ch, byte x, byte y, int color); // write ch to display X,Y coordinates using ASCII 5x7 font
 void WriteChar(char ch, int color); // writes character to display at current cursor position.
+void TextRun (byte cols[][5], byte count, byte x, byte y, int color); // stream count glyphs as one 6*count x 8 window in a single RAMWR burst
 void WriteString(char *text, int color); // writes string to display at current cursor position.
 void WriteInt(int i); // writes integer i at current cursor position
 void WriteHex(int i); // writes hexadecimal value of integer i at current cursor position
+//  ---------------------------------------------------------------------------//  RETAINED SCENE
+//
+// A scene is a list of nodes (filled rects, filled circles, lines, text)
+// drawn in id order, so a higher id is on top. Changing a node with the
+// Scene* setters marks its old and new bounds as damaged; setting the
+// same values again costs nothing. SceneUpdate then repaints only the
+// damaged rectangles: each one is clipped, filled with the background
+// (or not, when a rect node covers it) and the nodes that touch it are
+// drawn again in order; the caller's clip rectangle is put back after.
+// Background, rects and circles go through the compositor, so
+// overlapping ones are not sent twice. Text is not copied: the string
+// must stay valid, and SceneText has to be called again after changing
+// it in place.
+//
+// Build with -DTFT_SCENE for it. The node table takes 10 bytes per node
+// and the damage list 4 per rectangle: 176 bytes at the default sizes,
+// which can be lowered with -DSCENE_NODES=n and -DSCENE_DAMAGE=n.
+#ifdef TFT_SCENE
+#ifndef SCENE_NODES
+#define SCENE_NODES 16  // node ids 0..SCENE_NODES-1
+#endif
+#ifndef SCENE_DAMAGE
+#define SCENE_DAMAGE 4  // damaged rectangles kept before they are merged
+#endif
+#define SCENE_NONE  0
+#define SCENE_RECT  1
+#define SCENE_FILLCIRCLE 2
+#define SCENE_LINE  3
+#define SCENE_TEXT  4
+typedef struct
+{
+	byte type;  // SCENE_NONE, SCENE_RECT, ...
+	byte visible;
+	byte x0, y0, x1, y1;  // rect corners, line ends; circle: centre x0,y0, radius x1; text: origin x0,y0, bounds x1,y1
+	int color;
+	const char *text;
+} SceneNode;
+typedef struct
+{
+	byte x0, y0, x1, y1;
+} SceneRect;
+void SceneClear (int bg); // forget all nodes; the screen is taken to show bg already (e.g. after ClearScreen)
+byte SceneBounds (SceneNode *node, SceneRect *r); // screen rectangle covered by a visible node; 0 if none
+void SceneDamageNode (SceneNode *node); // mark what node covers for repainting
+void SceneSet (byte id, byte type, byte x0, byte y0, byte x1, byte y1, int color, const char *text); // change node id, damaging its old and new bounds
+void SceneFillRect (byte id, byte x0, byte y0, byte x1, byte y1, int color); // node id is a filled rectangle
+void SceneFillCircle (byte id, byte x, byte y, byte r, int color); // node id is a filled circle
+void SceneLine (byte id, byte x0, byte y0, byte x1, byte y1, int color); // node id is a line
+void SceneText (byte id, byte x, byte y, const char *text, int color); // node id is a 5x7 text string
+void SceneShow (byte id, byte visible); // show or hide node id
+void SceneDamage (byte x0, byte y0, byte x1, byte y1); // mark a rectangle for repainting
+void SceneDraw (SceneNode *node); // draw one node, clipped to the current clip rectangle
+void SceneUpdate(); // repaint every damaged rectangle
+#endif
+//  ---------------------------------------------------------------------------//  TIME-SLICED JOBS
+//
+// JobFillRect, JobClearScreen, JobFillCircle and JobString queue the
+// drawing and return at once. Each JobRun(budget) call then sends at
+// most about budget bytes (window and RAMWR bytes included) and returns,
+// so the main loop can poll inputs between calls. A call always makes
+// progress: at least one unit (a row of a fill or circle, one 6x8 text
+// cell), which is 320 bytes at most in landscape plus 11 for the window.
+// A circle row also walks RoundHalf, up to radius steps of about a byte
+// time each, and is charged radius bytes for it. Worst case per call is
+// therefore max(budget, 331 + radius) byte times; at 8 MHz and SCK osc/2
+// a byte takes at most 21 cycles (2.6 us), so JobRun(JOB_BUDGET) blocks
+// for less than 1.6 ms, and less than 1 ms without circles over radius
+// 50. The queue holds JOB_QUEUE jobs; queueing
+// into a full queue runs jobs until there is room. Fills and circles
+// are clipped to the clip rectangle in force when their rows are sent.
+//
+// Build with -DTFT_JOBS for them (11 bytes of RAM per queued job).
+// Without it JobBusy is 0 and JobRun does nothing, so an idle loop
+// that polls them still builds.
+#ifdef TFT_JOBS
+#define JOB_QUEUE 4  // queued jobs, must be a power of two
+#define JOB_BUDGET 256  // byte times per JobRun call
+#define JOB_FILL  1
+#define JOB_CIRCLE  2
+#define JOB_TEXT  3
+typedef struct
+{
+	byte type;  // JOB_FILL, JOB_CIRCLE, JOB_TEXT
+	byte x0, y0, x1, y1;  // fill: rectangle; circle: centre x0,y0, radius x1; text: origin x0,y0
+	int color;
+	const char *text;
+	int next;  // progress: rows done (fill, circle) or characters sent (text)
+} Job;
+void JobFillRect (byte x0, byte y0, byte x1, byte y1, int color); // queue a filled rectangle
+void JobClearScreen(); // queue a full screen clear
+void JobFillCircle (byte xPos, byte yPos, byte radius, int color); // queue a filled circle
+void JobString (byte x, byte y, const char *text, int color); // queue a text line of 6x8 cells at x,y; the string must stay valid
+byte JobRun (unsigned int budget); // send about budget bytes of queued drawing; nonzero while jobs remain
+byte JobBusy(); // nonzero while jobs remain
+Job *JobAdd (byte type); // next free queue slot, running jobs until there is one
+byte JobStep (Job *job, unsigned int *spent, unsigned int budget); // one job's share of a JobRun; nonzero when the job is done
+#else
+#define JobRun(budget) do {} while (0)
+#define JobBusy() 0
+#endif
+//  ---------------------------------------------------------------------------//  STRIP CHART
+//
+// Sweep-mode trace: each StripAdd draws the new sample at the cursor
+// column as a vertical span joined to the previous sample, and blanks
+// the column ahead of the cursor, so the newest data replaces the oldest
+// from left to right like a monitor trace. The chart keeps the last
+// width samples, one per column, oldest at the cursor (the blank column,
+// its sample kept but no longer shown). A column's span follows from its
+// sample and the one to its left, so a tick sends two single-column
+// windows covering only the rows that change (a few dozen bytes), not
+// the plot. A plot one column wide has no blank column.
+#define STRIP_MAX 128  // widest plot, in columns
+#define STRIP_NONE 0xFF  // no sample in the column yet
+typedef struct
+{
+	byte x0, y0, x1, y1;  // plot area
+	int color, bg;  // trace and background colors
+	byte cursor;  // column of the next sample, 0 = x0
+	byte sample[STRIP_MAX];  // row of the sample in each column, or STRIP_NONE
+} StripChart;
+void StripBegin (StripChart *sc, byte x0, byte y0, byte x1, byte y1, int color, int bg); // clear the plot area and start at its left edge
+void StripAdd (StripChart *sc, byte value); // plot value (0 = bottom row) at the cursor and advance it
+void StripSpan (StripChart *sc, byte col, byte left, byte *lo, byte *hi); // rows the sample of column col covers, joined to left (the sample to its left then)
+void StripColumn (StripChart *sc, byte col, byte oldLo, byte oldHi, byte lo, byte hi); // show rows lo..hi of column col in the trace color, the rest of oldLo..oldHi in bg
 //  ---------------------------------------------------------------------------//  TEST ROUTINES
 void PixelTest(); // draws 4000 pixels on the screen
 void LineTest(); // sweeps Line routine through all four quadrants.
@@ -146,4 +639,5 @@ void CircleTest(); // draw series of concentric circles
 void PortraitChars();// Writes 420 characters (5x7) to screen in portrait mode
 //  ---------------------------------------------------------------------------//  MAIN PROGRAM
 
-void InitTFT();
\ No newline at end of file
+void InitTFT(); // init, clear the screen, display on
+void InitTFTNoClear(); // init with the display off: paint the whole first frame, then DisplayOn
\ No newline at end of file
@@ -0,0 +1,1169 @@
+//-----------------------------------------------------------------------------//  TFT_BENCH: bus traffic benchmarks for tft.c on the host emulator
+//
+// Each scenario starts from a freshly initialised display, runs one
+// workload and reports what went over the SPI bus:
+//   bytes    - command + parameter + pixel bytes
+//   windows  - address window changes (SetAddrWindow calls that sent CASET/RASET)
+//   us       - estimated time at the SPI clock OpenSPI configures
+//
+// Usage: tft_bench [-v] [-c] [outdir]
+//   -v      also print the per-primitive StatsReport of every scenario
+//   -c      then compare the frames of the scenarios that must draw the
+//           same picture (see checks[]) and run the seeded checks
+//           (tests[]); exit status 1 on any difference or failed check,
+//           or if a timed kernel ran at an SCK too slow for it (WCOL)
+//   outdir  save the final framebuffer of every scenario as outdir/<name>.ppm
+//
+// Built by 'make bench' in this directory with -DTFT_HOST -DTFT_STATS.
+//
+//  ---------------------------------------------------------------------------//  INCLUDES
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tft.h"
+
+#define BENCH_SEED 1  // fixed rand() seed, so PixelTest draws the same points every run
+
+//  ---------------------------------------------------------------------------//  ROBOT SCENARIOS
+//
+// The face from tft_smile/tft_smile.c: every button press clears the
+// screen and redraws all of it in the new state.
+static void RobotLeftEye()
+{
+	FillRect(10,10,50,50,YELLOW);
+	FillCircle(30,30,15,RED);
+}
+static void RobotRightEye(char isBlinking)
+{
+	if (isBlinking)
+	{
+		FillRect(80,25,120,35,YELLOW);
+		HLine(80,120,30,BLACK);
+		return;
+	}
+	FillRect(80,10,120,50,YELLOW);
+	FillCircle(100,30,15,RED);
+}
+static void RobotMouth(char isFunny)
+{
+	byte top = isFunny ? 125 : 135;  // lateral pieces move with the mood
+	FillRect(20,top,30,top+15,YELLOW);
+	FillRect(30,130,100,145,YELLOW);
+	FillRect(100,top,110,top+15,YELLOW);
+}
+static void DrawRobot(char isFunny, char isBlinking)
+{
+	RobotLeftEye();
+	RobotRightEye(isBlinking);
+	FillRect(60,60,70,110,YELLOW);  // nose
+	RobotMouth(isFunny);
+}
+static void RobotSetup()
+{
+	DrawRobot(1,0);
+}
+static void RobotFirstFrame()
+{
+	ClearScreen();
+	DrawRobot(1,0);
+}
+static void RobotSmileToggle()
+{
+	ClearScreen();
+	DrawRobot(0,0);
+}
+static void RobotBlinkToggle()
+{
+	ClearScreen();
+	DrawRobot(1,1);
+}
+
+// The face once more, composited: pupils are not sent over the eyes.
+static void CompositeRobotItems()
+{
+	CompositeBegin();
+	CompositeFillRect(10,10,50,50,YELLOW);
+	CompositeFillCircle(30,30,15,RED);
+	CompositeFillRect(80,10,120,50,YELLOW);
+	CompositeFillCircle(100,30,15,RED);
+	CompositeFillRect(60,60,70,110,YELLOW);
+	CompositeFillRect(20,125,30,140,YELLOW);
+	CompositeFillRect(30,130,100,145,YELLOW);
+	CompositeFillRect(100,125,110,140,YELLOW);
+}
+static void CompositeRobot()
+{
+	ClearScreen();
+	CompositeRobotItems();
+	CompositeCommit();
+}
+static void BandRobot()
+{
+	CompositeRobotItems();
+	BandCommit(0,0,XMAX,YMAX,BLACK);
+}
+
+// Power-on to first face: InitTFT clears and then the face is drawn, or
+// InitTFTNoClear leaves the display off while one full-screen band pass
+// paints background and face together.
+static void BootClear()
+{
+	InitTFT();
+	CompositeRobotItems();
+	CompositeCommit();
+}
+static void BootFirstFrame()
+{
+	InitTFTNoClear();
+	BandRobot();
+	DisplayOn();
+}
+
+// The same face as retained scene nodes, as tft_smile draws it now:
+// a state change repaints only the damaged rectangles.
+static void SceneRobot(char isFunny, char isBlinking)
+{
+	byte top = isFunny ? 125 : 135;
+	SceneFillRect(0,10,10,50,50,YELLOW);
+	SceneFillCircle(1,30,30,15,RED);
+	if (isBlinking)
+		SceneFillRect(2,80,25,120,35,YELLOW);
+	else
+		SceneFillRect(2,80,10,120,50,YELLOW);
+	SceneFillCircle(3,100,30,15,RED);
+	SceneLine(4,80,30,120,30,BLACK);
+	SceneShow(3,!isBlinking);
+	SceneShow(4,isBlinking);
+	SceneFillRect(5,60,60,70,110,YELLOW);
+	SceneFillRect(6,20,top,30,top+15,YELLOW);
+	SceneFillRect(7,30,130,100,145,YELLOW);
+	SceneFillRect(8,100,top,110,top+15,YELLOW);
+	SceneUpdate();
+}
+static void SceneSetup()
+{
+	SceneClear(BLACK);
+	SceneRobot(1,0);
+}
+static void SceneSmileToggle()
+{
+	SceneRobot(0,0);
+}
+static void SceneBlinkToggle()
+{
+	SceneRobot(1,1);
+}
+
+//  ---------------------------------------------------------------------------//  SCENARIOS
+static void Clear()
+{
+	ClearScreen();
+}
+static void Pixels()
+{
+	srand(BENCH_SEED);
+	PixelTest();
+}
+static Point scatter[4000];
+static void PixelsBatched()
+// the same 4000 points, plotted with one DrawPixels call
+{
+	srand(BENCH_SEED);
+	ClearScreen();
+	for (int i=0; i<4000; i++)
+	{
+		scatter[i].x = rand() % XMAX;  // as PixelTest draws them
+		scatter[i].y = rand() % YMAX;
+	}
+	DrawPixels(scatter,4000,YELLOW);
+}
+static void PixelsColumns()
+// and sorted by column
+{
+	srand(BENCH_SEED);
+	ClearScreen();
+	for (int i=0; i<4000; i++)
+	{
+		scatter[i].x = rand() % XMAX;
+		scatter[i].y = rand() % YMAX;
+	}
+	DrawPixelsColumns(scatter,4000,YELLOW);
+}
+// A noisy trace: 8 samples per column, coming left to right.
+static void TracePoints()
+{
+	srand(BENCH_SEED);
+	for (int i=0; i<1024; i++)
+	{
+		scatter[i].x = i/8;
+		scatter[i].y = 60 + (i/8)%40 + rand()%12;
+	}
+}
+static void TracePixels()
+{
+	TracePoints();
+	ClearScreen();
+	for (int i=0; i<1024; i++)
+		DrawPixel(scatter[i].x,scatter[i].y,YELLOW);
+}
+static void TraceColumns()
+{
+	TracePoints();
+	ClearScreen();
+	DrawPixelsColumns(scatter,1024,YELLOW);
+}
+static void TrendLines()
+// dashboard-style near-horizontal lines across the full width
+{
+	for (int y=0; y<140; y+=7)
+		Line(0,y,XMAX,y+(y%20),GREEN);
+}
+static void RoundButtons()
+// a 2x5 grid of rounded button outlines
+{
+	for (byte row=0; row<5; row++)
+		for (byte col=0; col<2; col++)
+			RoundRect(4+col*62,4+row*31,60+col*62,30+row*31,6,WHITE);
+}
+static void FilledShapes()
+// gauge-style filled shapes: dials, pills and a panel
+{
+	for (byte r=4; r<40; r+=6)
+		FillCircle(64,50,r,r & 2 ? RED : YELLOW);
+	FillEllipse(64,110,100,30,BLUE);
+	FillRoundRect(10,130,117,155,8,GREEN);
+}
+static void StatusLines(int tick)
+// a full screen of status lines, numbers and hex values;
+// tick changes the readings on lines 3 and 7
+{
+	for (byte line=0; line<20; line++)
+	{
+		int t = line*123-400;
+		if (line == 3 || line == 7)
+			t += tick;
+		GotoLine(line);
+		WriteString("T=",GREEN);
+		WriteInt(t);
+		WriteString(" ADC 0x",GREEN);
+		WriteHex(line*4097);
+		WriteString(" OK",YELLOW);
+	}
+}
+static void StatusText()
+{
+	ClearScreen();
+	StatusLines(0);
+}
+static void StatusUpdate()
+// the next 10 Hz refresh: every line rewritten, two readings changed
+{
+	StatusLines(1);
+}
+static void ConsoleSetup()
+// a header line and a full console of log lines
+{
+	ConsoleBegin(1);
+	GotoLine(0);
+	WriteString("FIELD UNIT 7  LOG",YELLOW);
+	GotoLine(1);
+	for (int i=0; i<19; i++)
+	{
+		WriteString("boot step ",GREEN);
+		WriteInt(i);
+		if (i < 18)
+			WriteString("\n",GREEN);
+	}
+}
+static void ConsoleLog()
+// five more log lines: each one scrolls the console
+{
+	for (int i=0; i<5; i++)
+	{
+		WriteString("\nsensor ",CYAN);
+		WriteInt(i*7);
+		WriteString(" mV ok",WHITE);
+	}
+}
+#define STRIP_TICKS 100  // one second of samples at 100 Hz
+static StripChart strip;
+static byte StripSample(int i)
+// a triangle wave with some ripple, 0..58
+{
+	int t = i % 64;
+	return (t < 32 ? t*2 : (63-t)*2) * 7/8 + (i*37) % 5;
+}
+static void StripSetup()
+{
+	StripBegin(&strip,0,40,127,103,LIME,BLACK);
+	for (int i=0; i<128; i++)
+		StripAdd(&strip,StripSample(i));
+}
+static void StripTicks()
+// 100 samples through the strip chart
+{
+	for (int i=128; i<128+STRIP_TICKS; i++)
+		StripAdd(&strip,StripSample(i));
+}
+static void StripRedraw()
+// the same 100 samples the old way: clear the plot, draw the polyline
+{
+	for (int i=128; i<128+STRIP_TICKS; i++)
+	{
+		FillRect(0,40,127,103,BLACK);
+		for (int x=1; x<128; x++)
+			Line(x-1,103-StripSample(i-128+x-1),x,103-StripSample(i-128+x),LIME);
+	}
+}
+static void Panel(int value)
+// a two-color instrument panel, cleared and drawn in full
+{
+	ClearScreen();
+	DrawRect(0,0,XMAX,YMAX,WHITE);
+	GotoXY(1,1);
+	WriteString("PRESSURE  kPa",WHITE);
+	GotoXY(1,3);
+	WriteInt(value);
+	DrawRect(8,40,119,52,WHITE);
+	FillRect(10,42,10+value,50,WHITE);
+	Circle(64,100,30,WHITE);
+	Line(64,100,34+value*3/5,78,WHITE);
+	GotoXY(1,18);
+	WriteString("PUMP1 ON  PUMP2 OFF",WHITE);
+}
+static void PanelSetup()
+{
+	Panel(40);
+}
+static void PanelRedraw()
+// next reading, drawn straight to the panel
+{
+	Panel(41);
+}
+static void MonoSetup()
+{
+	MonoBegin(WHITE,BLACK);
+	Panel(40);
+	MonoFlush();
+}
+static void MonoPanel()
+// next reading, drawn into the 1bpp framebuffer and flushed
+{
+	Panel(41);
+	MonoEnd();
+}
+static void JobsDirect()
+// a clear, a dial and a status line, drawn blocking
+{
+	ClearScreen();
+	FillCircle(64,80,50,RED);
+	GotoLine(19);
+	WriteString("JOBS DONE",WHITE);
+}
+static unsigned long jobWorst;  // longest JobRun call, us
+static void JobsSliced()
+// the same, queued and sent in JOB_BUDGET slices
+{
+	JobClearScreen();
+	JobFillCircle(64,80,50,RED);
+	JobString(0,152,"JOBS DONE",WHITE);
+	jobWorst = 0;
+	for (;;)
+	{
+		unsigned long start = HostMicros();
+		byte busy = JobRun(JOB_BUDGET);
+		if (HostMicros()-start > jobWorst)
+			jobWorst = HostMicros()-start;
+		if (!busy)
+			break;
+	}
+}
+static void AsyncFills()
+// the same frame as robot_first's rectangles, queued to the SPI pump
+{
+	ClearScreenAsync();
+	FillRectAsync(10,10,50,50,YELLOW);
+	FillRectAsync(80,10,120,50,YELLOW);
+	FillRectAsync(60,60,70,110,YELLOW);
+	FillRectAsync(20,125,30,140,YELLOW);
+	FillRectAsync(30,130,100,145,YELLOW);
+	FillRectAsync(100,125,110,140,YELLOW);
+	PumpWait();
+}
+static void SyncFills()
+// the same, drawn with the blocking calls
+{
+	ClearScreen();
+	FillRect(10,10,50,50,YELLOW);
+	FillRect(80,10,120,50,YELLOW);
+	FillRect(60,60,70,110,YELLOW);
+	FillRect(20,125,30,140,YELLOW);
+	FillRect(30,130,100,145,YELLOW);
+	FillRect(100,125,110,140,YELLOW);
+}
+static void SlowSpi()
+// SCK at osc/8, slow enough for the pump to leave the program time
+{
+	SetSpiDivider(8);
+}
+// A full-screen gradient: red down the screen, green across.
+static int Gradient(byte x, byte y)
+{
+	byte red = y*31/YMAX;
+	return (red << 11) | ((x*63/XMAX) << 5) | (31-red);
+}
+static void GradientSource(byte x, byte y, byte n, int *pixels)
+{
+	for (byte i=0; i<n; i++)
+		pixels[i] = Gradient(x+i,y);
+}
+static void GradientPixels()
+{
+	for (byte y=0; y<=YMAX; y++)
+		for (byte x=0; x<=XMAX; x++)
+			DrawPixel(x,y,Gradient(x,y));
+}
+static void GradientStream()
+{
+	StreamWindow(0,0,XMAX,YMAX,GradientSource);
+}
+// Pixel streams left short, each on an odd pixel in 12-bit mode, with
+// drawing after them: the pixel after the last one sent must keep its color.
+static void ShortWindows()
+{
+	int px[5] = { RED, GREEN, BLUE, YELLOW, CYAN };
+	FillRect(0,0,63,63,WHITE);
+	for (byte n=1; n<=5; n++)
+	{
+		BeginWindow(4,8*n,11,8*n+3);
+		PushPixels(px,n);
+		EndWindow();
+		DrawPixel(20,8*n,MAGENTA);
+	}
+	BeginWindow(30,4,32,6);  // short in the middle of a row
+	PushColor(GREEN,5);
+	EndWindow();
+	FillRect(40,4,47,7,RED);
+}
+static void Mode444()
+// 12-bit pixels for the *_444 scenarios
+{
+	SetColorMode(12);
+}
+static void Slow444()
+{
+	SlowSpi();
+	Mode444();
+}
+
+typedef struct
+{
+	const char *name;
+	void (*setup)();  // untimed: puts the screen in the starting state
+	void (*run)();  // timed workload
+} Scenario;
+
+static const Scenario scenarios[] =
+{
+	{ "clear", 0, Clear },
+	{ "pixels", 0, Pixels },
+	{ "pixels_batched", 0, PixelsBatched },
+	{ "pixels_columns", 0, PixelsColumns },
+	{ "trace_pixels", 0, TracePixels },
+	{ "trace_columns", 0, TraceColumns },
+	{ "lines", 0, LineTest },
+	{ "trend_lines", 0, TrendLines },
+	{ "circles", 0, CircleTest },
+	{ "round_buttons", 0, RoundButtons },
+	{ "filled_shapes", 0, FilledShapes },
+	{ "chars", 0, PortraitChars },
+	{ "status_text", 0, StatusText },
+	{ "status_update", StatusText, StatusUpdate },
+	{ "console_log", ConsoleSetup, ConsoleLog },
+	{ "strip_chart", StripSetup, StripTicks },
+	{ "strip_redraw", 0, StripRedraw },
+	{ "panel_redraw", PanelSetup, PanelRedraw },
+	{ "mono_panel", MonoSetup, MonoPanel },
+	{ "boot_clear", 0, BootClear },
+	{ "boot_first_frame", 0, BootFirstFrame },
+	{ "robot_first", 0, RobotFirstFrame },
+	{ "robot_composite", 0, CompositeRobot },
+	{ "robot_band", 0, BandRobot },
+	{ "async_fills", 0, AsyncFills },
+	{ "jobs_direct", 0, JobsDirect },
+	{ "jobs_sliced", 0, JobsSliced },
+	{ "robot_smile", RobotSetup, RobotSmileToggle },
+	{ "robot_blink", RobotSetup, RobotBlinkToggle },
+	{ "scene_smile", SceneSetup, SceneSmileToggle },
+	{ "scene_blink", SceneSetup, SceneBlinkToggle },
+	{ "gradient_pixels", 0, GradientPixels },
+	{ "gradient_stream", 0, GradientStream },
+	{ "clear_444", Mode444, Clear },
+	{ "status_text_444", Mode444, StatusText },
+	{ "robot_band_444", Mode444, BandRobot },
+	{ "async_fills_444", Mode444, AsyncFills },
+	{ "fills_slow", SlowSpi, SyncFills },
+	{ "async_fills_slow", SlowSpi, AsyncFills },
+	{ "status_text_slow", SlowSpi, StatusText },
+	{ "status_text_444_slow", Slow444, StatusText },
+	{ "short_windows", 0, ShortWindows },
+	{ "short_windows_444", Mode444, ShortWindows },
+};
+#define SCENARIOS (sizeof(scenarios)/sizeof(scenarios[0]))
+
+// Scenarios that draw the same picture by different means. With reduce
+// the second one runs in 12-bit mode: it must show the first one's
+// colors cut to RGB444.
+typedef struct
+{
+	const char *a, *b;
+	byte reduce;
+} Check;
+
+static const Check checks[] =
+{
+	{ "pixels", "pixels_batched", 0 },
+	{ "pixels", "pixels_columns", 0 },
+	{ "trace_pixels", "trace_columns", 0 },
+	{ "robot_first", "robot_composite", 0 },
+	{ "robot_first", "robot_band", 0 },
+	{ "boot_clear", "boot_first_frame", 0 },
+	{ "fills_slow", "async_fills", 0 },
+	{ "fills_slow", "async_fills_slow", 0 },
+	{ "status_text", "status_text_slow", 0 },
+	{ "jobs_direct", "jobs_sliced", 0 },
+	{ "gradient_pixels", "gradient_stream", 0 },
+	{ "clear", "clear_444", 1 },
+	{ "status_text", "status_text_444", 1 },
+	{ "status_text", "status_text_444_slow", 1 },
+	{ "robot_band", "robot_band_444", 1 },
+	{ "async_fills", "async_fills_444", 1 },
+	{ "short_windows", "short_windows_444", 1 },
+};
+
+static uint16_t *frames[SCENARIOS];  // final panel contents, for the checks
+static uint16_t *Frame(const char *name)
+{
+	for (unsigned i=0; i<SCENARIOS; i++)
+		if (!strcmp(scenarios[i].name,name))
+			return frames[i];
+	return 0;
+}
+static int RunChecks()
+// compare the frames checks[] pairs up; returns the number that differ
+{
+	int failed = 0;
+	for (unsigned i=0; i<sizeof(checks)/sizeof(checks[0]); i++)
+	{
+		const Check *ck = &checks[i];
+		uint16_t *a = Frame(ck->a), *b = Frame(ck->b);
+		long diff = 0;
+		if (!a || !b)
+			diff = -1;
+		else
+			for (int p=0; p<HOST_XSIZE*HOST_YSIZE; p++)
+				if (b[p] != (ck->reduce ? Color565(Color444(a[p])) : a[p]))
+					diff++;
+		if (diff < 0)
+			printf("check %s = %s: no such scenario\n",ck->a,ck->b);
+		else if (diff)
+			printf("check %s = %s: %ld pixels differ\n",ck->a,ck->b,diff);
+		else
+			printf("check %s = %s: ok\n",ck->a,ck->b);
+		if (diff)
+			failed++;
+	}
+	return failed;
+}
+
+//  ---------------------------------------------------------------------------//  SEEDED CHECKS
+//
+// Randomized and exhaustive checks for -c. Trial t draws from rand()
+// seeded with BENCH_SEED+t, so a failing trial can be replayed. Each
+// returns how many pixels came out wrong, 0 if the trial passed.
+typedef struct
+{
+	const char *name;
+	int trials;
+	long (*run)(int trial);
+} Test;
+
+static void Snapshot(uint16_t *frame)
+{
+	for (int y=0; y<HOST_YSIZE; y++)
+		for (int x=0; x<HOST_XSIZE; x++)
+			frame[y*HOST_XSIZE+x] = HostPixel(x,y);
+}
+static uint16_t ref[HOST_XSIZE*HOST_YSIZE];  // reference drawing of a trial
+static long Differ(const uint16_t *frame, byte reduce)
+// pixels on the panel other than in frame (cut to RGB444 with reduce)
+{
+	long diff = 0;
+	for (int y=0; y<HOST_YSIZE; y++)
+		for (int x=0; x<HOST_XSIZE; x++)
+			if (HostPixel(x,y) != (reduce ? Color565(Color444(frame[y*HOST_XSIZE+x])) : frame[y*HOST_XSIZE+x]))
+				diff++;
+	return diff;
+}
+static long Lit()
+// pixels on the panel that are not black
+{
+	long lit = 0;
+	for (int y=0; y<HOST_YSIZE; y++)
+		for (int x=0; x<HOST_XSIZE; x++)
+			if (HostPixel(x,y))
+				lit++;
+	return lit;
+}
+static void Fresh()
+// a cleared panel, no clip
+{
+	HostInit();
+	InitTFT();
+}
+static long SentOnce()
+// pixels sent more than once (or lit without being sent) since the
+// counters were cleared, on a panel that was black
+{
+	return labs(2*Lit() - (long)hostBus.pixels)/2;
+}
+
+static long CircleOnce(int trial)
+// every outline pixel of radius trial sent exactly once
+{
+	Fresh();
+	HostClearCounters();
+	Circle(64,80,trial,WHITE);
+	return SentOnce();
+}
+static long RoundRectOnce(int trial)
+{
+	byte x0 = rand()%64, y0 = rand()%80, x1 = x0+rand()%64, y1 = y0+rand()%80;
+	byte side = x1-x0 < y1-y0 ? x1-x0 : y1-y0;
+	Fresh();
+	HostClearCounters();
+	RoundRect(x0,y0,x1,y1,trial%(side/2+1),WHITE);
+	return SentOnce();
+}
+
+static long FillCircleOnce(int trial)
+// every pixel of radius trial sent once, the outline inside the fill
+{
+	Fresh();
+	HostClearCounters();
+	FillCircle(64,80,trial,WHITE);
+	long wrong = SentOnce(), lit = Lit();
+	Circle(64,80,trial,WHITE);
+	return wrong + Lit()-lit;
+}
+static long FillRoundRectOnce(int trial)
+{
+	byte x0 = rand()%64, y0 = rand()%80, x1 = x0+rand()%64, y1 = y0+rand()%80;
+	byte side = x1-x0 < y1-y0 ? x1-x0 : y1-y0, r = trial%(side/2+1);
+	Fresh();
+	HostClearCounters();
+	FillRoundRect(x0,y0,x1,y1,r,WHITE);
+	long wrong = SentOnce(), lit = Lit();
+	RoundRect(x0,y0,x1,y1,r,WHITE);
+	return wrong + Lit()-lit;
+}
+static long EllipseShape(int trial)
+// every width and height centred on the screen against the old
+// FillEllipse: its search for the half-width of each row, redone here.
+// Each trial draws in its own color, so the panel is never cleared.
+{
+	int width = trial/HOST_YSIZE, height = trial%HOST_YSIZE;
+	int a = width/2, b = height/2, half[HOST_YSIZE/2+1];
+	long a2 = a*a, b2 = b*b, wrong = 0, lit = 0;
+	half[0] = a;
+	for (int y=1, x1, dx = 0; y<=b; y++)
+	{
+		for (x1 = half[y-1]-(dx-1); x1>0; x1--)
+			if (b2*x1*x1 + a2*y*y <= a2*b2)
+				break;
+		dx = half[y-1]-x1;
+		half[y] = x1;
+	}
+	if (!trial)
+		Fresh();
+	HostClearCounters();
+	FillEllipse(64,80,width,height,trial+1);
+	for (int y=79-b; y<=81+b; y++)
+		for (int x=63-a; x<=65+a; x++)
+		{
+			byte in = abs(y-80) <= b && abs(x-64) <= half[abs(y-80)];
+			if ((HostPixel(x,y) == trial+1) != in)
+				wrong++;
+			lit += in;
+		}
+	return wrong + labs(2*lit - (long)hostBus.pixels)/2;
+}
+
+// Overlapping rectangles, circles and lines for the compositor.
+typedef struct
+{
+	byte kind;  // 0 rectangle, 1 circle of radius x1, 2 line
+	byte x0, y0, x1, y1;
+	int color;
+} Shape;
+static Shape shapes[12];
+static int shapeCount;
+static void RandomShapes(int most)
+// 1 to most shapes: over COMPOSITE_ITEMS they are committed in turns
+{
+	shapeCount = 1+rand()%most;
+	for (int i=0; i<shapeCount; i++)
+	{
+		Shape *sh = &shapes[i];
+		byte xa = rand()%HOST_XSIZE, ya = rand()%HOST_YSIZE, xb = rand()%HOST_XSIZE, yb = rand()%HOST_YSIZE;
+		sh->kind = rand()%3;
+		sh->color = rand() & 0xFFFF;
+		sh->x0 = xa < xb ? xa : xb; sh->x1 = xa < xb ? xb : xa;
+		sh->y0 = ya < yb ? ya : yb; sh->y1 = ya < yb ? yb : ya;
+		if (sh->kind == 1)
+		{
+			sh->x0 = xa; sh->y0 = ya;
+			sh->x1 = xb%50;
+		}
+		if (sh->kind == 2)
+			sh->y1 = sh->y0;
+	}
+}
+static void PaintShapes()
+// in painter's order, straight to the panel
+{
+	for (int i=0; i<shapeCount; i++)
+		if (shapes[i].kind == 1)
+			FillCircle(shapes[i].x0,shapes[i].y0,shapes[i].x1,shapes[i].color);
+		else
+			FillRect(shapes[i].x0,shapes[i].y0,shapes[i].x1,shapes[i].y1,shapes[i].color);
+}
+static void QueueShapes()
+// the same to the compositor
+{
+	CompositeBegin();
+	for (int i=0; i<shapeCount; i++)
+		if (shapes[i].kind == 1)
+			CompositeFillCircle(shapes[i].x0,shapes[i].y0,shapes[i].x1,shapes[i].color);
+		else if (shapes[i].kind == 2)
+			CompositeHLine(shapes[i].x0,shapes[i].x1,shapes[i].y0,shapes[i].color);
+		else
+			CompositeFillRect(shapes[i].x0,shapes[i].y0,shapes[i].x1,shapes[i].y1,shapes[i].color);
+}
+static long CompositeOrder(int trial)
+// CompositeCommit draws what painting in order draws, every third
+// trial clipped
+{
+	RandomShapes(12);
+	Fresh();
+	if (trial%3 == 0)
+		SetClip(20,30,100,120);
+	PaintShapes();
+	Snapshot(ref);
+	Fresh();
+	if (trial%3 == 0)
+		SetClip(20,30,100,120);
+	QueueShapes();
+	CompositeCommit();
+	return Differ(ref,0);
+}
+
+static long BandOrder(int trial)
+// BandCommit over bg into a random area draws what filling the area
+// and painting in order draws, every third trial clipped as well
+{
+	RandomShapes(COMPOSITE_ITEMS);  // a band list must fit the queue
+	byte x0 = rand()%64, y0 = rand()%80, x1 = 64+rand()%64, y1 = 80+rand()%80;
+	int bg = rand() & 0xFFFF;
+	Fresh();
+	if (trial%3 == 0)
+		SetClip(20,30,100,120);
+	SetClip(x0 > clipX0 ? x0 : clipX0,y0 > clipY0 ? y0 : clipY0,x1 < clipX1 ? x1 : clipX1,y1 < clipY1 ? y1 : clipY1);
+	FillRect(0,0,XMAX,YMAX,bg);
+	PaintShapes();
+	Snapshot(ref);
+	Fresh();
+	if (trial%3 == 0)
+		SetClip(20,30,100,120);
+	QueueShapes();
+	BandCommit(x0,y0,x1,y1,bg);
+	return Differ(ref,0);
+}
+
+static void MonoScene(int trial, byte flush)
+// three batches of two-color fills, lines, circles, pixels and text;
+// with flush, flushed after the first and the last
+{
+	srand(BENCH_SEED+trial);
+	for (int k=0; k<3; k++)
+	{
+		for (int i=1+rand()%10; i>0; i--)
+		{
+			byte xa = rand()%HOST_XSIZE, ya = rand()%HOST_YSIZE, xb = rand()%HOST_XSIZE, yb = rand()%HOST_YSIZE;
+			byte r = rand()%40;
+			int color = rand()%3 ? WHITE : BLACK;
+			switch (rand()%8)
+			{
+				case 0: FillRect(xa < xb ? xa : xb,ya < yb ? ya : yb,xa < xb ? xb : xa,ya < yb ? yb : ya,color); break;
+				case 1: Line(xa,ya,xb,yb,color); break;
+				case 2: FillCircle(xa,ya,r,color); break;
+				case 3: Circle(xa,ya,r,color); break;
+				case 4: PutCh('A'+r,xa%120,ya%150,WHITE); break;
+				case 5: DrawPixel(xa,ya,color); break;
+				case 6: GotoXY(xa%21,ya%20); WriteString("Hi 42",WHITE); break;
+				case 7: FillEllipse(xa,ya,r+2,r/2+2,color); break;
+			}
+		}
+		if (flush && k != 1)
+			MonoFlush();
+	}
+}
+static long MonoOrder(int trial)
+// drawing through the framebuffer, with partial flushes, ends in the
+// frame drawing directly does
+{
+	Fresh();
+	MonoScene(trial,0);
+	Snapshot(ref);
+	Fresh();
+	MonoBegin(WHITE,BLACK);
+	MonoScene(trial,1);
+	MonoEnd();
+	return Differ(ref,0);
+}
+
+static void MixedScene(int trial)
+// 40 random fills, pixels, text, lines, circles, async fills,
+// composites and bands
+{
+	srand(BENCH_SEED+trial);
+	for (int i=0; i<40; i++)
+	{
+		byte x0 = rand()%HOST_XSIZE, y0 = rand()%HOST_YSIZE;
+		byte x1 = x0+rand()%(HOST_XSIZE-x0), y1 = y0+rand()%(HOST_YSIZE-y0);
+		int color = rand() & 0xFFFF;
+		switch (rand()%9)
+		{
+			case 0: FillRect(x0,y0,x1,y1,color); break;
+			case 1: DrawPixel(x0,y0,color); break;
+			case 2: PutCh('A'+rand()%26,x0%120,y0%150,color); break;
+			case 3: GotoXY(rand()%15,rand()%18); WriteString("Hi 0123",color); break;
+			case 4: FillRectAsync(x0,y0,x1,y1,color); break;
+			case 5: FillCircle(40+rand()%40,40+rand()%60,1+rand()%30,color); break;
+			case 6: Line(x0,y0,x1,y1,color); break;
+			case 7:
+				CompositeBegin();
+				CompositeFillRect(x0,y0,x1,y1,color);
+				CompositeFillCircle(60,80,rand()%30,color^0x5555);
+				CompositeCommit();
+				break;
+			case 8:
+				CompositeBegin();
+				CompositeFillRect(x0,y0,x1,y1,color);
+				CompositeFillCircle(60,80,rand()%30,color^0x5555);
+				BandCommit(x0/2,y0/2,x1,y1,color^0xF0F0);
+				break;
+		}
+	}
+	PumpWait();
+}
+static long Reduced444(int trial)
+// the same drawing in 12-bit mode shows the RGB565 frame cut to RGB444
+{
+	Fresh();
+	MixedScene(trial);
+	Snapshot(ref);
+	Fresh();
+	SetColorMode(12);
+	MixedScene(trial);
+	return Differ(ref,1);
+}
+
+// A window streamed in random pieces, every third row one solid color.
+static int StreamColor(byte x, byte y)
+{
+	return (x*517) ^ (y*3001) ^ 0x1234;
+}
+static void StreamSource(byte x, byte y, byte n, int *pixels)
+{
+	for (byte i=0; i<n; i++)
+		pixels[i] = StreamColor(x+i,y);
+}
+static long StreamOrder(int trial)
+// a random window streamed, in 12-bit mode on odd trials, draws what
+// DrawPixel does pixel by pixel. Half the trials clip to a random
+// rectangle; every third one stops the stream short at a random pixel.
+{
+	byte x0 = rand()%HOST_XSIZE, y0 = rand()%HOST_YSIZE;
+	byte x1 = x0+rand()%(HOST_XSIZE-x0), y1 = y0+rand()%(HOST_YSIZE-y0);
+	byte cx0 = 0, cy0 = 0, cx1 = XMAX, cy1 = YMAX;
+	if (trial%4 < 2)
+	{
+		cx0 = rand()%HOST_XSIZE; cy0 = rand()%HOST_YSIZE;
+		cx1 = cx0+rand()%(HOST_XSIZE-cx0); cy1 = cy0+rand()%(HOST_YSIZE-cy0);
+	}
+	int width = x1-x0+1, total = width*(y1-y0+1);
+	int limit = trial%3 == 0 ? rand()%total : total;
+	byte source = limit == total && rand()%2;  // StreamWindow, no solid rows
+	for (byte pass=0; pass<2; pass++)
+	{
+		Fresh();
+		if (trial & 1)
+			SetColorMode(12);
+		FillRect(0,0,XMAX,YMAX,0x7BEF);  // grey
+		SetClip(cx0,cy0,cx1,cy1);
+		if (!pass)
+		{
+			for (int i=0; i<limit; i++)
+			{
+				byte x = x0+i%width, y = y0+i/width;
+				DrawPixel(x,y,!source && (y-y0)%3 == 0 ? 0x0F0F : StreamColor(x,y));
+			}
+			Snapshot(ref);
+		}
+		else if (source)
+			StreamWindow(x0,y0,x1,y1,StreamSource);
+		else
+		{
+			BeginWindow(x0,y0,x1,y1);
+			for (int i=0; i<limit; )
+			{
+				int pixels[37], n = 1+rand()%37;
+				if ((i/width)%3 == 0 && i%width == 0 && i+width <= limit)
+				{
+					PushColor(0x0F0F,width);
+					i += width;
+					continue;
+				}
+				if (n > limit-i)
+					n = limit-i;
+				if ((i/width)%3 == 0)  // stop at the solid row
+					n = 1;
+				for (int j=0; j<n; j++)
+				{
+					byte x = x0+(i+j)%width, y = y0+(i+j)/width;
+					pixels[j] = (y-y0)%3 == 0 ? 0x0F0F : StreamColor(x,y);
+				}
+				PushPixels(pixels,n);
+				i += n;
+			}
+			EndWindow();
+		}
+	}
+	return Differ(ref,0);
+}
+
+static long PointsOrder(int trial)
+// up to 4000 random points, some off the screen, drawn with DrawPixels
+// (DrawPixelsColumns on odd trials) light what DrawPixel lights. Half
+// the trials clip to a random rectangle.
+{
+	int n = rand()%4000, spread = 1+rand()%256, color = rand() & 0xFFFF;
+	byte cx0 = 0, cy0 = 0, cx1 = XMAX, cy1 = YMAX;
+	if (trial%4 < 2)
+	{
+		cx0 = rand()%HOST_XSIZE; cy0 = rand()%HOST_YSIZE;
+		cx1 = cx0+rand()%(HOST_XSIZE-cx0); cy1 = cy0+rand()%(HOST_YSIZE-cy0);
+	}
+	for (int i=0; i<n; i++)
+	{
+		scatter[i].x = rand()%spread;
+		scatter[i].y = rand()%(spread+32 < 256 ? spread+32 : 256);
+	}
+	Fresh();
+	SetClip(cx0,cy0,cx1,cy1);
+	for (int i=0; i<n; i++)
+		DrawPixel(scatter[i].x,scatter[i].y,color);
+	Snapshot(ref);
+	Fresh();
+	SetClip(cx0,cy0,cx1,cy1);
+	if (trial & 1)
+		DrawPixelsColumns(scatter,n,color);
+	else
+		DrawPixels(scatter,n,color);
+	return Differ(ref,0);
+}
+
+static long StripOrder(int trial)
+// up to three sweeps of random samples through a strip chart 1 to 128
+// columns wide show each column's latest sample joined to the one
+// before it, and a blank column at the cursor
+{
+	static byte rows[3*STRIP_MAX];
+	byte width = trial < 8 ? 1+trial : 1+rand()%STRIP_MAX, y0 = rand()%40, y1 = y0+rand()%100;
+	byte x0 = rand()%(HOST_XSIZE-width+1);
+	int n = rand()%(3*width+1);
+	Fresh();
+	StripBegin(&strip,x0,y0,x0+width-1,y1,LIME,BLUE);
+	for (int k=0; k<n; k++)
+	{
+		byte value = rand()%(y1-y0+8);  // some over the top
+		rows[k] = value > y1-y0 ? y0 : y1-value;
+		StripAdd(&strip,value);
+	}
+	Snapshot(ref);
+	Fresh();
+	FillRect(x0,y0,x0+width-1,y1,BLUE);
+	for (int k = n > width ? n-width : 0; k<n; k++)
+	{
+		byte col = k%width, lo = rows[k], hi = rows[k];
+		if (width > 1 && col == n%width)  // the blank column
+			continue;
+		if (col && k)
+		{
+			if (rows[k-1] < lo) lo = rows[k-1];
+			if (rows[k-1] > hi) hi = rows[k-1];
+		}
+		VLine(x0+col,lo,hi,LIME);
+	}
+	return Differ(ref,0);
+}
+
+static long SceneClip(int trial)
+// SceneUpdate repaints the robot's damage and leaves the caller's clip
+// rectangle as it found it
+{
+	byte x0 = rand()%HOST_XSIZE, y0 = rand()%HOST_YSIZE;
+	byte x1 = x0+rand()%(HOST_XSIZE-x0), y1 = y0+rand()%(HOST_YSIZE-y0);
+	Fresh();
+	SceneSetup();
+	SetClip(x0,y0,x1,y1);
+	SceneRobot(trial & 1,trial & 2);
+	return (clipX0 != x0) + (clipY0 != y0) + (clipX1 != x1) + (clipY1 != y1);
+}
+
+static long ResetState(int trial)
+// InitDisplay after drawing in another orientation, clip and pixel mode
+// turns the display on and draws as after a fresh InitTFT
+{
+	byte x0 = rand()%HOST_XSIZE, y0 = rand()%HOST_YSIZE;
+	Fresh();
+	FillRect(10,20,60,90,RED);
+	Snapshot(ref);
+	Fresh();
+	SetOrientation(90*(trial%4));
+	SetClip(x0,y0,x0+rand()%(HOST_XSIZE-x0),y0+rand()%(HOST_YSIZE-y0));
+	if (trial & 4)
+		SetColorMode(12);
+	FillRect(0,0,XMAX,YMAX,BLUE);
+	InitDisplay();
+	long wrong = !HostDisplayOn();
+	ClearScreen();
+	FillRect(10,20,60,90,RED);
+	return wrong + Differ(ref,0);
+}
+
+static const Test tests[] =
+{
+	{ "circle_once", 60, CircleOnce },
+	{ "round_rect_once", 200, RoundRectOnce },
+	{ "fill_circle_once", 60, FillCircleOnce },
+	{ "fill_round_rect_once", 200, FillRoundRectOnce },
+	{ "ellipse_shape", HOST_XSIZE*HOST_YSIZE, EllipseShape },
+	{ "composite_order", 300, CompositeOrder },
+	{ "band_order", 300, BandOrder },
+	{ "mono_order", 200, MonoOrder },
+	{ "reduced_444", 200, Reduced444 },
+	{ "stream_order", 400, StreamOrder },
+	{ "points_order", 300, PointsOrder },
+	{ "strip_order", 300, StripOrder },
+	{ "scene_clip", 20, SceneClip },
+	{ "reset_state", 40, ResetState },
+};
+
+static int RunTests()
+// run every trial of tests[]; returns the number of checks that failed
+{
+	int failed = 0;
+	for (unsigned i=0; i<sizeof(tests)/sizeof(tests[0]); i++)
+	{
+		const Test *t = &tests[i];
+		int bad = 0, first = 0;
+		for (int trial=0; trial<t->trials; trial++)
+		{
+			srand(BENCH_SEED+trial);
+			if (t->run(trial) && !bad++)
+				first = trial;
+		}
+		if (bad)
+		{
+			printf("test %s: %d of %d trials wrong, first %d\n",t->name,bad,t->trials,first);
+			failed++;
+		}
+		else
+			printf("test %s: %d trials ok\n",t->name,t->trials);
+	}
+	return failed;
+}
+
+//  ---------------------------------------------------------------------------//  MAIN PROGRAM
+static void PrintLine(char *line)
+{
+	printf("  %s\n",line);
+}
+
+int main(int argc, char **argv)
+{
+	int verbose = 0, check = 0, overruns = 0;
+	const char *outdir = 0;
+	for (int i=1; i<argc; i++)
+	{
+		if (!strcmp(argv[i],"-v"))
+			verbose = 1;
+		else if (!strcmp(argv[i],"-c"))
+			check = 1;
+		else
+			outdir = argv[i];
+	}
+	printf("scenario,bytes,commands,params,pixels,windows,us\n");
+	for (unsigned i=0; i<SCENARIOS; i++)
+	{
+		const Scenario *sc = &scenarios[i];
+		HostInit();
+		InitTFT();
+		if (sc->setup)
+			sc->setup();
+		HostClearCounters();
+		StatsClear();
+		sc->run();
+		unsigned long windows = 0;
+		for (int p=0; p<STAT_COUNT; p++)
+			windows += tftStats[p].windows;
+		printf("%s,%lu,%lu,%lu,%lu,%lu,%lu\n",sc->name,
+			hostBus.commands+hostBus.params+hostBus.pixels,
+			hostBus.commands,hostBus.params,hostBus.pixels,windows,HostMicros());
+		if (sc->run == JobsSliced)
+			printf("  longest JobRun(%d): %lu us\n",JOB_BUDGET,jobWorst);
+		if (hostBus.isr)
+			printf("  pump interrupts: %lu us, program left %lu us\n",
+				(unsigned long)(hostBus.isr/(F_CPU/1000000UL)),
+				(unsigned long)((hostBus.cycles-hostBus.isr)/(F_CPU/1000000UL)));
+		if (hostBus.overruns)
+		{
+			printf("  WCOL: %lu kernel bytes sent over a byte in flight\n",hostBus.overruns);
+			overruns++;
+		}
+		if (verbose)
+			StatsReport(PrintLine);
+		if (outdir)
+		{
+			char path[256];
+			snprintf(path,sizeof(path),"%s/%s.ppm",outdir,sc->name);
+			if (HostSavePPM(path))
+				fprintf(stderr,"cannot write %s\n",path);
+		}
+		if (check)
+		{
+			frames[i] = malloc(HOST_XSIZE*HOST_YSIZE*sizeof(uint16_t));
+			Snapshot(frames[i]);
+		}
+	}
+	if (check)
+	{
+		int failed = RunChecks();
+		failed += RunTests();
+		if (failed || overruns)
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,331 @@
+//-----------------------------------------------------------------------------//  TFT_HOST: ST7735 emulator for running tft.c on a PC
+//
+// The controller is modelled at the level the driver uses it:
+// - D/C low selects a command, the following data bytes are its parameters
+// - CASET/RASET set the address window, RAMWR restarts the write pointer
+//   at the window origin, pixels then fill the window row by row
+// - MADCTL MY/MX/MV (bits 7/6/5) mirror and exchange the address axes
+// - COLMOD 3 (12-bit), 5 (16-bit) and 6 (18-bit) pixel formats; a 12-bit
+//   pixel is stored as soon as its third nibble arrives
+// - vertical scrolling: VSCRDEF sets the fixed and scrolled line ranges,
+//   VSCSAD the memory line shown first in the scroll area, NORON ends it
+// - a low RESET line or SWRESET restores the power-on defaults
+// - bus timing of the SPI port or of USART0 in Master SPI mode, whichever
+//   the driver has enabled
+//
+// Writes that land outside the panel are dropped, like the real GRAM.
+//
+//  ---------------------------------------------------------------------------//  INCLUDES
+#include <string.h>
+#include "tft.h"
+
+//  ---------------------------------------------------------------------------//  GLOBAL VARIABLES
+volatile uint8_t DDRB, PORTB, PINB, DDRD, SPCR, SPSR;
+volatile uint8_t UCSR0A, UCSR0B, UCSR0C;
+volatile uint16_t UBRR0;
+HostCounters hostBus;
+
+static uint16_t gram[HOST_YSIZE][HOST_XSIZE];  // panel pixels, RGB565
+static uint8_t dc = 1, reset = 1;  // state of the D/C and RESET lines
+static uint8_t cmd;  // last command received
+static uint8_t argc, args[8];  // parameters received for cmd
+static uint8_t madctl, colmod, sleeping, displayOn;
+static uint16_t xs, xe, ys, ye;  // address window
+static uint16_t col, row;  // write pointer
+static uint8_t pixc, pix[3];  // bytes of a partly received pixel
+static uint16_t tfa, vsa, ssa;  // scroll: top fixed lines, scrolled lines, start line
+static uint8_t scrolling;  // nonzero between VSCSAD and NORON
+
+//  ---------------------------------------------------------------------------//  CONTROLLER MODEL
+static void PowerOn()
+// power-on / reset defaults from the ST7735 datasheet
+{
+	cmd = 0x00; argc = 0; pixc = 0;
+	madctl = 0x00;
+	colmod = 0x06;  // 18-bit pixels
+	sleeping = 1;
+	displayOn = 0;
+	xs = 0; xe = HOST_XSIZE-1;
+	ys = 0; ye = HOST_YSIZE-1;
+	col = 0; row = 0;
+	tfa = 0; vsa = HOST_YSIZE; ssa = 0;
+	scrolling = 0;
+}
+static void StorePixel(uint16_t color)
+// write one pixel at the pointer, then advance it through the window
+{
+	int maxCol = (madctl & 0x20) ? HOST_YSIZE-1 : HOST_XSIZE-1;
+	int maxRow = (madctl & 0x20) ? HOST_XSIZE-1 : HOST_YSIZE-1;
+	if (col <= maxCol && row <= maxRow)
+	{
+		int c = (madctl & 0x40) ? maxCol-col : col;  // MX: mirror columns
+		int r = (madctl & 0x80) ? maxRow-row : row;  // MY: mirror rows
+		if (madctl & 0x20)  // MV: columns run down the panel
+			gram[c][r] = color;
+		else
+			gram[r][c] = color;
+	}
+	if (++col > xe)
+	{
+		col = xs;
+		if (++row > ye)
+			row = ys;
+	}
+}
+static void PixelByte(uint8_t b)
+// assemble pixel data according to COLMOD
+{
+	pix[pixc++] = b;
+	if (colmod == 0x03 && pixc == 2)  // 12-bit: RGBR GBRG BRGB
+		StorePixel(Color565((pix[0] << 4) | (pix[1] >> 4)));
+	else if (colmod == 0x03 && pixc == 3)
+	{
+		StorePixel(Color565(((pix[1] & 0x0F) << 8) | pix[2]));
+		pixc = 0;
+	}
+	else if (colmod == 0x05 && pixc == 2)
+	{
+		StorePixel((pix[0] << 8) | pix[1]);
+		pixc = 0;
+	}
+	else if (pixc == 3)  // 18-bit: one byte per channel, upper 6 bits used
+	{
+		StorePixel(((pix[0] & 0xF8) << 8) | ((pix[1] & 0xFC) << 3) | (pix[2] >> 3));
+		pixc = 0;
+	}
+}
+static void Command(uint8_t b)
+{
+	cmd = b;
+	argc = 0;
+	pixc = 0;
+	switch (cmd)
+	{
+		case 0x01: PowerOn(); break;  // SWRESET
+		case 0x11: sleeping = 0; break;  // SLPOUT
+		case 0x13: scrolling = 0; break;  // NORON
+		case 0x28: displayOn = 0; break;  // DISPOFF
+		case 0x29: displayOn = 1; break;  // DISPON
+		case 0x2C: col = xs; row = ys; break;  // RAMWR
+	}
+}
+static void Param(uint8_t b)
+{
+	if (argc < sizeof(args))
+		args[argc] = b;
+	argc++;
+	switch (cmd)
+	{
+		case 0x2A:  // CASET
+			if (argc == 4)
+			{
+				xs = (args[0] << 8) | args[1];
+				xe = (args[2] << 8) | args[3];
+			}
+			break;
+		case 0x2B:  // RASET
+			if (argc == 4)
+			{
+				ys = (args[0] << 8) | args[1];
+				ye = (args[2] << 8) | args[3];
+			}
+			break;
+		case 0x33:  // VSCRDEF
+			if (argc == 6)
+			{
+				tfa = (args[0] << 8) | args[1];
+				vsa = (args[2] << 8) | args[3];
+			}
+			break;
+		case 0x36: if (argc == 1) madctl = b; break;  // MADCTL
+		case 0x37:  // VSCSAD
+			if (argc == 2)
+			{
+				ssa = (args[0] << 8) | args[1];
+				scrolling = 1;
+			}
+			break;
+		case 0x3A: if (argc == 1) colmod = b & 0x07; break;  // COLMOD
+	}
+}
+
+//  ---------------------------------------------------------------------------//  BUS INTERFACE
+void HostInit()
+// power-on the emulated controller and clear the counters
+{
+	memset(gram,0,sizeof(gram));
+	dc = 1;
+	reset = 1;
+	PowerOn();
+	HostClearCounters();
+}
+void HostClearCounters()
+{
+	memset(&hostBus,0,sizeof(hostBus));
+}
+static int UsartMode()
+// nonzero when the driver has USART0 in Master SPI mode
+{
+	return (UCSR0C & (_BV(UMSEL01)|_BV(UMSEL00))) == (_BV(UMSEL01)|_BV(UMSEL00)) && (UCSR0B & _BV(TXEN0));
+}
+static void Receive(uint8_t b)
+// controller side of one byte
+{
+	if (!reset)  // controller held in reset
+		return;
+	if (dc == 0)
+	{
+		hostBus.commands++;
+		Command(b);
+	}
+	else if (cmd == 0x2C)  // RAMWR
+	{
+		hostBus.pixels++;
+		PixelByte(b);
+	}
+	else
+	{
+		hostBus.params++;
+		Param(b);
+	}
+}
+void HostSpiOut(uint8_t b)
+// one byte shifted out on MOSI
+{
+	hostBus.cycles += HostByteCycles();
+	Receive(b);
+}
+void HostSpiStream(uint8_t b)
+// one byte from the Stream565 kernel: the next SPDR write is scheduled
+// by cycle count instead of polling SPIF
+{
+	hostBus.cycles += HostByteCycles();
+	if (!UsartMode())
+	{
+		hostBus.cycles += HOST_KERNEL_GAP - HOST_SPI_GAP;
+		if (HostByteCycles() - HOST_SPI_GAP > 16 + HOST_KERNEL_GAP)  // slower than osc/2
+			hostBus.overruns++;  // the AVR would drop this byte
+	}
+	Receive(b);
+}
+void HostSpiIrq(uint8_t b)
+// one byte from the pump interrupt: the next one follows when both the
+// wire and the interrupt are done, and the interrupt time is not the program's
+{
+	unsigned int wire = HostByteCycles();
+	hostBus.cycles += wire > HOST_ISR_CYCLES ? wire : HOST_ISR_CYCLES;
+	hostBus.isr += HOST_ISR_CYCLES;
+	Receive(b);
+}
+void HostSetDC(uint8_t level)
+{
+	dc = level;
+}
+void HostSetReset(uint8_t level)
+{
+	if (!level)
+		PowerOn();
+	reset = level;
+}
+void HostDelayUs(unsigned long us)
+{
+	hostBus.cycles += (unsigned long long)us * (F_CPU/1000000UL);
+}
+void HostCpuCycles(unsigned long cycles)
+{
+	hostBus.cycles += cycles;
+}
+unsigned int HostByteCycles()
+// 8 SCK periods at the divider selected by SPR1:0 and SPI2X, plus the gap.
+// USART0 in Master SPI mode runs at osc/(2*(UBRR0+1)) back to back.
+{
+	static const uint8_t divider[4] = { 4, 16, 64, 128 };
+	if (UsartMode())
+		return 16 * (UBRR0+1);
+	unsigned int cycles = 8 * divider[SPCR & 0x03];
+	if (SPSR & _BV(SPI2X))
+		cycles /= 2;
+	return cycles + HOST_SPI_GAP;
+}
+unsigned long HostMicros()
+// elapsed time in microseconds
+{
+	return hostBus.cycles / (F_CPU/1000000UL);
+}
+
+//  ---------------------------------------------------------------------------//  INSPECTION
+uint16_t HostPixel(int x, int y)
+// what the panel shows: memory line y, or the scrolled line in scroll mode
+{
+	if (x < 0 || x >= HOST_XSIZE || y < 0 || y >= HOST_YSIZE)
+		return 0;
+	if (scrolling && vsa && y >= tfa && y < tfa+vsa)
+	{
+		y = ssa + (y - tfa);
+		if (y >= tfa+vsa)
+			y -= vsa;
+		if (y >= HOST_YSIZE)
+			return 0;
+	}
+	return gram[y][x];
+}
+uint8_t HostMadctl()
+{
+	return madctl;
+}
+uint8_t HostColmod()
+{
+	return colmod;
+}
+uint8_t HostDisplayOn()
+{
+	return displayOn && !sleeping;
+}
+int HostSavePPM(const char *path)
+// write the panel as a binary PPM, 8 bits per channel
+{
+	FILE *f = fopen(path,"wb");
+	if (!f)
+		return -1;
+	fprintf(f,"P6\n%d %d\n255\n",HOST_XSIZE,HOST_YSIZE);
+	for (int y=0; y<HOST_YSIZE; y++)
+		for (int x=0; x<HOST_XSIZE; x++)
+		{
+			uint16_t c = HostPixel(x,y);
+			fputc((c >> 8) & 0xF8,f);  // red
+			fputc((c >> 3) & 0xFC,f);  // green
+			fputc((c << 3) & 0xF8,f);  // blue
+		}
+	return fclose(f);
+}
+
+//  ---------------------------------------------------------------------------//  AVR-LIBC EXTENSIONS
+char *ltoa(long value, char *str, int radix)
+{
+	char tmp[34];
+	char *p = str;
+	unsigned long v = value;
+	int i = 0;
+	if (value < 0 && radix == 10)
+	{
+		*p++ = '-';
+		v = -value;
+	}
+	do
+	{
+		int d = v % radix;
+		tmp[i++] = d < 10 ? '0'+d : 'a'+d-10;
+		v /= radix;
+	} while (v);
+	while (i)
+		*p++ = tmp[--i];
+	*p = 0;
+	return str;
+}
+char *itoa(int value, char *str, int radix)
+// like avr-libc: non-decimal radixes print the 16-bit two's complement
+{
+	if (radix != 10)
+		return ltoa((unsigned int)(value & 0xFFFF),str,radix);
+	return ltoa(value,str,radix);
+}
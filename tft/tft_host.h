@@ -0,0 +1,69 @@
+//-----------------------------------------------------------------------------//  TFT_HOST: ST7735 emulator for running tft.c on a PC
+//
+// Build tft.c with -DTFT_HOST and link tft_host.c instead of flashing the
+// board. The emulator decodes the command stream the driver sends
+// (CASET, RASET, RAMWR, MADCTL, COLMOD, ...) into a 128x160 GRAM model,
+// and counts every byte on the wire and every CPU cycle spent on the bus.
+//
+// Pixels are stored in panel order: x=0..127 left to right, y=0..159 top
+// to bottom, with the panel held in portrait orientation (MADCTL = 0).
+//
+//  ---------------------------------------------------------------------------//  AVR STAND-INS
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#ifndef F_CPU
+#define F_CPU 8000000UL  // 8 MHz osc, same as the board
+#endif
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define _BV(bit) (1 << (bit))
+#define _delay_ms(ms) HostDelayUs((ms)*1000UL)
+#define _delay_us(us) HostDelayUs(us)
+#define SPI2X 0
+#define SPIE 7
+#define UMSEL01 7  // USART0 bits used by TFT_USART_SPI
+#define UMSEL00 6
+#define TXEN0 3
+#define UDRIE0 5
+#define cli()  // no interrupts on the host
+#define sei()
+extern volatile uint8_t DDRB, PORTB, PINB, DDRD, SPCR, SPSR;  // plain variables on the host
+extern volatile uint8_t UCSR0A, UCSR0B, UCSR0C;
+extern volatile uint16_t UBRR0;
+char *itoa(int value, char *str, int radix);  // avr-libc extensions
+char *ltoa(long value, char *str, int radix);
+//  ---------------------------------------------------------------------------//  EMULATOR
+#define HOST_XSIZE 128  // panel width in portrait
+#define HOST_YSIZE 160  // panel height in portrait
+#define HOST_SPI_GAP 5  // CPU cycles lost per byte polling SPIF and reloading SPDR
+                        // (none for USART MSPIM: its transmit register is buffered)
+#define HOST_KERNEL_GAP 2  // Stream565 writes SPDR every 18 cycles at osc/2
+#define HOST_ISR_CYCLES 40  // one pump interrupt: entry, PumpNext, exit
+typedef struct
+{
+	unsigned long commands;  // bytes sent with D/C low
+	unsigned long params;  // data bytes that are not pixel data
+	unsigned long pixels;  // data bytes following RAMWR
+	unsigned long long cycles;  // CPU cycles spent on the bus and in delays
+	unsigned long long isr;  // part of those taken by pump interrupts
+	unsigned long overruns;  // kernel bytes written while the last one still shifted (WCOL)
+} HostCounters;
+extern HostCounters hostBus;  // running totals since HostInit or HostClearCounters
+void HostInit(); // power-on the emulated controller and clear the counters
+void HostClearCounters(); // zero hostBus
+void HostSpiOut(uint8_t b); // one byte shifted out on MOSI
+void HostSpiStream(uint8_t b); // one byte from the Stream565 kernel, no polling gap
+void HostSpiIrq(uint8_t b); // one byte from the pump interrupt
+void HostSetDC(uint8_t level); // D/C line: 0=command, 1=data
+void HostSetReset(uint8_t level); // RESET line, active low
+void HostDelayUs(unsigned long us); // time passing without bus traffic
+void HostCpuCycles(unsigned long cycles); // CPU work the driver reports between bus bytes
+unsigned long HostMicros(); // elapsed time in microseconds, from hostBus.cycles
+unsigned int HostByteCycles(); // CPU cycles per byte for the configured SPI port or USART MSPIM
+uint16_t HostPixel(int x, int y); // RGB565 pixel the panel shows at x,y (after vertical scroll)
+uint8_t HostMadctl(); // current MADCTL parameter
+uint8_t HostColmod(); // current COLMOD parameter
+uint8_t HostDisplayOn(); // nonzero after SLPOUT and DISPON
+int HostSavePPM(const char *path); // write the panel as a binary PPM; 0 on success
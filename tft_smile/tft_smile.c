@@ -6,6 +6,9 @@
 #include "avr/io.h"
 #include <util/delay.h>
 #include "tft.h"
+#ifndef TFT_SCENE
+#error "the face is a retained scene: build with -DTFT_SCENE (tft_smile.aps)"
+#endif
 
 #define LEFT_EYE_POSX 10
 #define LEFT_EYE_POSY 10
@@ -23,41 +26,66 @@
 
 #define BUTTON_BLINKING 0b00000001
 #define BUTTON_SMILE 0b00000010
+#define BUTTON_MASK (BUTTON_BLINKING | BUTTON_SMILE)  // PB0, PB1, active low
 
-void drawLeftEye()
-{
+#define TICK_MS 4  // input timer period
+#define TICK_OCR (F_CPU / 256 * TICK_MS / 1000 - 1)  // timer 0 compare value at clk/256
+#define DEBOUNCE_TICKS 5  // quiet time before the pins are trusted again
+#define EVENT_QUEUE 8  // queued button events, must be a power of two
+
+#if defined(PCICR) && defined(PCINT0_vect)
+#define INPUT_PCINT  // buttons wake the CPU through the pin-change interrupt
+#define TICK_vect TIMER0_COMPA_vect
+#else
+#define TICK_vect TIMER0_COMP_vect  // ATmega16A: no pin-change interrupts, the tick polls
+#endif
+
+// scene node ids, bottom to top
+#define NODE_LEFT_EYE 0
+#define NODE_LEFT_PUPIL 1
+#define NODE_RIGHT_EYE 2
+#define NODE_RIGHT_PUPIL 3
+#define NODE_RIGHT_LID 4
+#define NODE_NOSE 5
+#define NODE_MOUTH_LEFT 6
+#define NODE_MOUTH_MIDDLE 7
+#define NODE_MOUTH_RIGHT 8
 
-    FillRect(LEFT_EYE_POSX, LEFT_EYE_POSY,
+void setLeftEye()
+{
+	SceneFillRect(NODE_LEFT_EYE, LEFT_EYE_POSX, LEFT_EYE_POSY,
 		LEFT_EYE_POSX + EYE_SIZE, LEFT_EYE_POSY + EYE_SIZE, YELLOW);
 
-	FillCircle(LEFT_EYE_POSX + EYE_SIZE / 2,
+	SceneFillCircle(NODE_LEFT_PUPIL, LEFT_EYE_POSX + EYE_SIZE / 2,
 		LEFT_EYE_POSY + EYE_SIZE / 2, PUPIL_RADIUS, RED);
 }
 
-void drawRightEye(char isBlinking)
+void setRightEye(char isBlinking)
 {
 	if (isBlinking) {
-		FillRect(RIGHT_EYE_POSX, RIGHT_EYE_POSY + 15,
+		SceneFillRect(NODE_RIGHT_EYE, RIGHT_EYE_POSX, RIGHT_EYE_POSY + 15,
 			RIGHT_EYE_POSX + EYE_SIZE, RIGHT_EYE_POSY + EYE_SIZE - 15, YELLOW);
-
-			HLine(RIGHT_EYE_POSX,RIGHT_EYE_POSX + EYE_SIZE,
-			 RIGHT_EYE_POSY + EYE_SIZE / 2, BLACK);
-		return;
+	} else {
+		SceneFillRect(NODE_RIGHT_EYE, RIGHT_EYE_POSX, RIGHT_EYE_POSY,
+			RIGHT_EYE_POSX + EYE_SIZE, RIGHT_EYE_POSY + EYE_SIZE, YELLOW);
 	}
 
-	FillRect(RIGHT_EYE_POSX, RIGHT_EYE_POSY,
-		RIGHT_EYE_POSX + EYE_SIZE, RIGHT_EYE_POSY + EYE_SIZE, YELLOW);
-	FillCircle(RIGHT_EYE_POSX + EYE_SIZE / 2,
+	SceneFillCircle(NODE_RIGHT_PUPIL, RIGHT_EYE_POSX + EYE_SIZE / 2,
 		RIGHT_EYE_POSY + EYE_SIZE / 2, PUPIL_RADIUS, RED);
+	SceneLine(NODE_RIGHT_LID, RIGHT_EYE_POSX, RIGHT_EYE_POSY + EYE_SIZE / 2,
+		RIGHT_EYE_POSX + EYE_SIZE, RIGHT_EYE_POSY + EYE_SIZE / 2, BLACK);
+
+	SceneShow(NODE_RIGHT_PUPIL, !isBlinking);
+	SceneShow(NODE_RIGHT_LID, isBlinking);
 }
 
-void drawNose()
+void setNose()
 {
-	FillRect(LEFT_SIDE_OF_NOSE, TOP_SIDE_OF_NOSE, RIGHT_SIDE_OF_NOSE,
-	 BOTTOM_SIDE_OF_NOSE, YELLOW);
+	SceneFillRect(NODE_NOSE, LEFT_SIDE_OF_NOSE, TOP_SIDE_OF_NOSE,
+		RIGHT_SIDE_OF_NOSE, BOTTOM_SIDE_OF_NOSE, YELLOW);
 }
 
-void drawMouth(char isFunny)
+void setMouth(char isFunny)
 {
 	char leftSideOfFirstPiece = 20;
 
@@ -80,40 +108,165 @@ void drawMouth(char isFunny)
 		bottomSideOfLateral = bottomSideOfSecond + 5;
 	}
 
-	FillRect(leftSideOfFirstPiece, topSideOfLateral,
+	SceneFillRect(NODE_MOUTH_LEFT, leftSideOfFirstPiece, topSideOfLateral,
 		rightSideOfFirstPiece,bottomSideOfLateral , YELLOW);
 
-	FillRect(rightSideOfFirstPiece, topSideOfSecond,
+	SceneFillRect(NODE_MOUTH_MIDDLE, rightSideOfFirstPiece, topSideOfSecond,
 		rightSideOfSecondPiece, bottomSideOfSecond, YELLOW);
 
-	FillRect(rightSideOfSecondPiece, topSideOfLateral,
+	SceneFillRect(NODE_MOUTH_RIGHT, rightSideOfSecondPiece, topSideOfLateral,
 		rightSideOfThirdPiece, bottomSideOfLateral, YELLOW);
 }
 
+// updates the robot's scene nodes and repaints only what changed
 void drawRobot(char isFunny, char isBlinking)
 {
-	drawLeftEye();
+	setLeftEye();
+
+	setRightEye(isBlinking);
+
+	setNose();
 
-	drawRightEye(isBlinking);
+	setMouth(isFunny);
 
-	drawNose();
+	SceneUpdate();
+}
+
+// button input: a press is queued as soon as its first edge is seen, then
+// the port is ignored until it has been quiet for DEBOUNCE_TICKS, so bounce
+// on press or release never makes a second event
+volatile char buttonState;  // debounced pressed buttons
+volatile char buttonQuiet;  // ticks left until pin changes are accepted again
+volatile unsigned int wakeTicks;  // ticks left until the wait_buttons deadline
+volatile char eventQueue[EVENT_QUEUE];
+volatile byte eventHead, eventTail;
+
+void tick_on()
+{
+#ifdef INPUT_PCINT
+	if (!(TIMSK0 & _BV(OCIE0A))) {
+		TCNT0 = 0;
+		TCCR0B = _BV(CS02);  // clk/256
+		TIMSK0 |= _BV(OCIE0A);
+	}
+#endif
+}
 
-	drawMouth(isFunny);
+void tick_off()
+{
+#ifdef INPUT_PCINT
+	TIMSK0 &= ~_BV(OCIE0A);
+	TCCR0B = 0;
+#endif
+}
+
+char tick_running()
+{
+#ifdef INPUT_PCINT
+	return TIMSK0 & _BV(OCIE0A);
+#else
+	return 1;
+#endif
 }
 
-char detect_buttons_in_delay(int delay)
+// called from the interrupts: queue buttons that went down
+void input_sample()
 {
-	static char previous_port = 0xFF;
-	int quant_count = delay / 10;
-	for (int quant_number = 0; quant_number < quant_count; ++quant_number) {
-		char current_port = PINB;
-		char buttons = ~current_port & previous_port;
-		previous_port = current_port;
-		if (buttons)
-			return buttons;
-		_delay_ms(10);
+	char pressed = ~PINB & BUTTON_MASK;
+	if (pressed == buttonState)
+		return;
+	if (buttonQuiet) {  // still bouncing: restart the quiet time
+		buttonQuiet = DEBOUNCE_TICKS;
+		return;
+	}
+	char event = pressed & ~buttonState;
+	buttonState = pressed;
+	buttonQuiet = DEBOUNCE_TICKS;
+	tick_on();
+	byte next = (eventHead + 1) & (EVENT_QUEUE - 1);
+	if (event && next != eventTail) {  // a full queue drops the event
+		eventQueue[eventHead] = event;
+		eventHead = next;
+	}
+}
+
+#ifdef INPUT_PCINT
+ISR(PCINT0_vect)
+{
+	input_sample();
+}
+#endif
+
+ISR(TICK_vect)
+{
+	if (wakeTicks)
+		wakeTicks--;
+	if (buttonQuiet)
+		buttonQuiet--;
+	if (!buttonQuiet)
+		input_sample();  // picks up a change made during the quiet time
+#ifdef INPUT_PCINT
+	if (!buttonQuiet && !wakeTicks)
+		tick_off();  // nothing to time: the next edge restarts it
+#endif
+}
+
+void input_init()
+{
+	PORTB |= BUTTON_MASK;  // pull-ups
+	DDRB &= ~BUTTON_MASK;
+	buttonState = ~PINB & BUTTON_MASK;  // buttons held at reset don't count
+#ifdef INPUT_PCINT
+	TCCR0A = _BV(WGM01);  // CTC, started by tick_on
+	OCR0A = TICK_OCR;
+	PCMSK0 = BUTTON_MASK;  // PB0, PB1 are PCINT0, PCINT1
+	PCICR |= _BV(PCIE0);
+#else
+	TCCR0 = _BV(WGM01) | _BV(CS02);  // CTC, clk/256
+	OCR0 = TICK_OCR;
+	TIMSK |= _BV(OCIE0);
+#endif
+	sei();
+}
+
+// returns the next button event, or 0 when timeout ms pass first
+// (0 waits for ever). Queued drawing jobs run in slices while waiting;
+// with nothing to do the CPU sleeps until an interrupt.
+char wait_buttons(unsigned int timeout)
+{
+	cli();
+	wakeTicks = (timeout + TICK_MS - 1) / TICK_MS;
+	if (wakeTicks)
+		tick_on();
+	sei();
+	while (1) {
+		cli();
+		if (eventHead != eventTail) {
+			char event = eventQueue[eventTail];
+			eventTail = (eventTail + 1) & (EVENT_QUEUE - 1);
+			sei();
+			return event;
+		}
+		if (timeout && !wakeTicks) {
+			sei();
+			return 0;
+		}
+		if (JobBusy()) {
+			sei();
+			JobRun(JOB_BUDGET);
+			continue;
+		}
+#ifdef INPUT_PCINT
+		if (!tick_running() && !PumpBusy())
+			set_sleep_mode(SLEEP_MODE_PWR_DOWN);  // only a button can wake us
+		else
+#endif
+			set_sleep_mode(SLEEP_MODE_IDLE);  // timer and SPI keep running
+		sleep_enable();
+		sei();
+		sleep_cpu();  // sei delays interrupts by one instruction: no lost wake-up
+		sleep_disable();
 	}
-	return 0x00;
 }
 
 int main()
@@ -122,18 +275,19 @@ int main()
 	DDRB = 0x00;
 
 	InitTFT();
+	input_init();
+	SceneClear(BLACK);
 	
 	char isFunny = 1, isBlinking = 0;
 	
 	drawRobot(isFunny, isBlinking);
 		
 	while (1){
-		char buttons = detect_buttons_in_delay(100);
+		char buttons = wait_buttons(0);
 		if (buttons & BUTTON_BLINKING) {
 			
 			if (!isFunny && isBlinking)
 				continue;
-			ClearScreen();
 			
 			isFunny = !isFunny;
 			drawRobot(isFunny, isBlinking);
@@ -143,7 +297,6 @@ int main()
 			if (!isFunny && !isBlinking)
 				continue;
 			
-			ClearScreen();
 			isBlinking = !isBlinking;
 			drawRobot(isFunny, isBlinking);
 		}